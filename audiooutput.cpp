@@ -0,0 +1,146 @@
+#include "audiooutput.h"
+
+#include <QDebug>
+
+AudioOutput::AudioOutput(int frequency, int samples)
+    : device(0),
+      head(0),
+      tail(0),
+      underruns(0),
+      overruns(0)
+{
+    this->ring = new qint16[AUDIO_RING_SIZE * 2];
+    memset(this->ring, 0, sizeof(qint16) * AUDIO_RING_SIZE * 2);
+
+    SDL_AudioSpec desired;
+    memset(&desired, 0, sizeof(SDL_AudioSpec));
+    memset(&this->spec, 0, sizeof(SDL_AudioSpec));
+
+    desired.freq = frequency;
+    desired.format = AUDIO_S16SYS;
+    desired.channels = 2;
+    desired.samples = samples;
+    desired.callback = &AudioOutput::callback;
+    desired.userdata = this;
+
+    this->device = SDL_OpenAudioDevice(nullptr, 0, &desired, &this->spec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+
+    if (this->device > 0) {
+        qDebug() << "Audio initialized!";
+        qDebug() << "Frequency" << this->spec.freq;
+        qDebug() << "Samples" << this->spec.samples;
+
+        SDL_PauseAudioDevice(this->device, 0);
+    } else {
+        qDebug() << "Failed to open audio device" << SDL_GetError();
+        this->device = 0;
+    }
+}
+
+AudioOutput::~AudioOutput()
+{
+    // Waits for a running callback
+    if (this->device)
+        SDL_CloseAudioDevice(this->device);
+
+    delete[] this->ring;
+}
+
+bool AudioOutput::isOpen() const
+{
+    return this->device != 0;
+}
+
+int AudioOutput::frequency() const
+{
+    return this->spec.freq;
+}
+
+int AudioOutput::deviceFrames() const
+{
+    return this->spec.samples;
+}
+
+int AudioOutput::write(const qint16* frames, int count)
+{
+    int head = this->head.load();
+    int free = AUDIO_RING_SIZE - 1 - ((head - this->tail.loadAcquire()) & (AUDIO_RING_SIZE - 1));
+    int written = qMin(count, free);
+
+    for (int i = 0; i < written; i++) {
+        this->ring[head * 2 + 0] = frames[i * 2 + 0];
+        this->ring[head * 2 + 1] = frames[i * 2 + 1];
+
+        head = (head + 1) & (AUDIO_RING_SIZE - 1);
+    }
+
+    this->head.storeRelease(head);
+
+    if (written < count)
+        this->overruns.fetchAndAddRelaxed(count - written);
+
+    return written;
+}
+
+double AudioOutput::rateAdjustment() const
+{
+    int target = this->targetFill();
+    double deviation = static_cast<double>(this->fillLevel() - target) / target;
+
+    // A fuller ring means consuming more input per output frame
+    return 1.0 + AUDIO_MAX_DEVIATION * qBound(-1.0, deviation, 1.0);
+}
+
+int AudioOutput::targetFill() const
+{
+    // Two device buffers queued in front of the one being played
+    return qMin(2 * qMax<int>(this->spec.samples, 256), AUDIO_RING_SIZE / 2);
+}
+
+int AudioOutput::fillLevel() const
+{
+    return (this->head.loadAcquire() - this->tail.loadAcquire()) & (AUDIO_RING_SIZE - 1);
+}
+
+int AudioOutput::capacity() const
+{
+    return AUDIO_RING_SIZE - 1;
+}
+
+int AudioOutput::takeUnderruns()
+{
+    return this->underruns.fetchAndStoreRelaxed(0);
+}
+
+int AudioOutput::takeOverruns()
+{
+    return this->overruns.fetchAndStoreRelaxed(0);
+}
+
+void AudioOutput::read(qint16* frames, int count)
+{
+    int tail = this->tail.load();
+    int available = (this->head.loadAcquire() - tail) & (AUDIO_RING_SIZE - 1);
+    int read = qMin(count, available);
+
+    for (int i = 0; i < read; i++) {
+        frames[i * 2 + 0] = this->ring[tail * 2 + 0];
+        frames[i * 2 + 1] = this->ring[tail * 2 + 1];
+
+        tail = (tail + 1) & (AUDIO_RING_SIZE - 1);
+    }
+
+    this->tail.storeRelease(tail);
+
+    if (read < count) {
+        memset(frames + read * 2, 0, sizeof(qint16) * 2 * (count - read));
+        this->underruns.fetchAndAddRelaxed(count - read);
+    }
+}
+
+void SDLCALL AudioOutput::callback(void* userdata, Uint8* stream, int length)
+{
+    AudioOutput* output = static_cast<AudioOutput*>(userdata);
+
+    output->read(reinterpret_cast<qint16*>(stream), length / (sizeof(qint16) * 2));
+}
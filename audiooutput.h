@@ -0,0 +1,65 @@
+#ifndef AUDIOOUTPUT_H
+#define AUDIOOUTPUT_H
+
+#include <QtGlobal>
+#include <QAtomicInt>
+
+#include <SDL2/SDL.h>
+
+// Frames the ring holds, power of two
+#define AUDIO_RING_SIZE     0x1000
+
+// Largest change of the resampling ratio dynamic rate control applies
+#define AUDIO_MAX_DEVIATION 0.005
+
+/*
+ * Plays interleaved 16 bit stereo frames through an SDL audio callback.
+ *
+ * The emulation thread writes into a single producer, single consumer ring which the
+ * callback drains on the audio thread, neither side ever blocks. Frames that do not
+ * fit are dropped and missing frames are played as silence, both are counted.
+ */
+class AudioOutput
+{
+public:
+    explicit AudioOutput(int frequency = 44100, int samples = 512);
+    ~AudioOutput();
+
+    bool    isOpen() const;
+    int     frequency() const;
+
+    // Frames the device fetches per callback
+    int     deviceFrames() const;
+
+    // Returns the amount of frames that fit into the ring, the rest is dropped
+    int     write(const qint16* frames, int count);
+
+    // Factor for the resampling ratio that moves the fill level towards targetFill().
+    // Producing slightly more or less keeps the ring from draining or overflowing when
+    // the emulation is paced by the wall clock or the display instead of the audio device.
+    double  rateAdjustment() const;
+    int     targetFill() const;
+
+    // Telemetry, safe to read from the emulation thread
+    int     fillLevel() const;
+    int     capacity() const;
+    int     takeUnderruns();
+    int     takeOverruns();
+
+private:
+    static void SDLCALL callback(void* userdata, Uint8* stream, int length);
+    void    read(qint16* frames, int count);
+
+private:
+    SDL_AudioDeviceID   device;
+    SDL_AudioSpec       spec;
+
+    qint16*     ring;
+    QAtomicInt  head;
+    QAtomicInt  tail;
+
+    QAtomicInt  underruns;
+    QAtomicInt  overruns;
+};
+
+#endif // AUDIOOUTPUT_H
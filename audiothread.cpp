@@ -0,0 +1,109 @@
+#include "audiothread.h"
+
+#include <chips/ym2612.h>
+#include <chips/sn76489.h>
+
+// Master cycles between wake ups, one block of native YM2612 samples
+#define AUDIO_WAKE_CYCLES (YM2612_DIVIDER * 144 * 128)
+
+AudioThread::AudioThread(Scheduler* scheduler, YM2612* ym2612, SN76489* psg, QObject* parent)
+    : QThread(parent),
+      scheduler(scheduler),
+      ym2612(ym2612),
+      psg(psg),
+      head(0),
+      tail(0),
+      produced(0),
+      lastWake(0),
+      rendered(0),
+      ymCycle(0),
+      psgCycle(0)
+{
+    this->log = new AudioLogEntry[AUDIO_LOG_SIZE];
+
+    this->start();
+}
+
+AudioThread::~AudioThread()
+{
+    this->push(AudioLogEntry{ 0, LOG_STOP, 0, 0 });
+    this->pending.release();
+    this->wait();
+
+    delete[] this->log;
+}
+
+void AudioThread::clock(int cycles)
+{
+    this->produced += cycles;
+    this->push(AudioLogEntry{ this->produced, LOG_SYNC, 0, 0 });
+
+    if (this->produced - this->lastWake >= AUDIO_WAKE_CYCLES) {
+        this->lastWake = this->produced;
+        this->pending.release();
+    }
+}
+
+void AudioThread::run()
+{
+    forever {
+        this->pending.acquire();
+
+        int tail = this->tail.load();
+
+        while (tail != this->head.loadAcquire()) {
+            const AudioLogEntry entry = this->log[tail];
+
+            tail = (tail + 1) & (AUDIO_LOG_SIZE - 1);
+            this->tail.storeRelease(tail);
+
+            switch (entry.type) {
+            case LOG_YM2612_PART_I:
+                this->renderTo(entry.cycle);
+                this->ym2612->write(0, entry.address, entry.value);
+                break;
+
+            case LOG_YM2612_PART_II:
+                this->renderTo(entry.cycle);
+                this->ym2612->write(1, entry.address, entry.value);
+                break;
+
+            case LOG_PSG:
+                this->renderTo(entry.cycle);
+                this->psg->write(entry.value);
+                break;
+
+            case LOG_SYNC:
+                this->renderTo(entry.cycle);
+                break;
+
+            case LOG_STOP:
+                return;
+            }
+        }
+    }
+}
+
+void AudioThread::renderTo(qint64 cycle)
+{
+    // The Z80 runs after the 68k, its writes may trail those the 68k made later in the slice
+    if (cycle <= this->rendered)
+        return;
+
+    // The YM2612 mixes in the PSG samples up to its own position
+    int ticks = static_cast<int>((cycle - this->psgCycle) / Z80_DIVIDER);
+
+    if (ticks > 0) {
+        this->psg->clock(ticks);
+        this->psgCycle += static_cast<qint64>(ticks) * Z80_DIVIDER;
+    }
+
+    ticks = static_cast<int>((cycle - this->ymCycle) / YM2612_DIVIDER);
+
+    if (ticks > 0) {
+        this->ym2612->synthesize(ticks);
+        this->ymCycle += static_cast<qint64>(ticks) * YM2612_DIVIDER;
+    }
+
+    this->rendered = cycle;
+}
@@ -0,0 +1,98 @@
+#ifndef AUDIOTHREAD_H
+#define AUDIOTHREAD_H
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QSemaphore>
+
+#include "scheduler.h"
+
+#define AUDIO_LOG_SIZE 0x4000
+
+class YM2612;
+class SN76489;
+
+struct AudioLogEntry {
+    qint64  cycle;
+    quint8  type;
+    quint8  address;
+    quint8  value;
+};
+
+/*
+ * Synthesizes the sound chips on their own thread.
+ *
+ * The emulation thread records every register write of the YM2612 and the PSG into a
+ * single producer, single consumer ring, stamped with the master cycle it happened at,
+ * together with a marker for how far the emulation has run. The audio thread replays
+ * the writes at their cycles and renders up to the marker, ahead of the audio device.
+ */
+class AudioThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum LogType {
+        LOG_YM2612_PART_I,
+        LOG_YM2612_PART_II,
+        LOG_PSG,
+        LOG_SYNC,
+        LOG_STOP,
+    };
+
+public:
+    AudioThread(Scheduler* scheduler, YM2612* ym2612, SN76489* psg, QObject* parent = nullptr);
+    ~AudioThread();
+
+    inline void write(LogType type, quint8 address, quint8 value) {
+        this->push(AudioLogEntry{ this->scheduler->timestamp(), static_cast<quint8>(type), address, value });
+    }
+
+    // Publishes the master cycles the emulation has run
+    void            clock(int cycles);
+
+protected:
+    void            run() override;
+
+private:
+    void            renderTo(qint64 cycle);
+
+    inline void push(const AudioLogEntry& entry) {
+        int head = this->head.load();
+        int next = (head + 1) & (AUDIO_LOG_SIZE - 1);
+
+        // Writes must not be lost, wake the audio thread and wait until it drained some entries
+        if (next == this->tail.loadAcquire()) {
+            this->pending.release();
+
+            while (next == this->tail.loadAcquire())
+                QThread::yieldCurrentThread();
+        }
+
+        this->log[head] = entry;
+        this->head.storeRelease(next);
+    }
+
+private:
+    Scheduler*      scheduler;
+    YM2612*         ym2612;
+    SN76489*        psg;
+
+    AudioLogEntry*  log;
+
+    QAtomicInt      head;
+    QAtomicInt      tail;
+
+    QSemaphore      pending;
+
+    // Emulation thread, master cycle published and when the audio thread was woken last
+    qint64          produced;
+    qint64          lastWake;
+
+    // Audio thread, master cycle each chip has been rendered up to
+    qint64          rendered;
+    qint64          ymCycle;
+    qint64          psgCycle;
+};
+
+#endif // AUDIOTHREAD_H
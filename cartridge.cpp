@@ -416,3 +416,41 @@ int Cartridge::poke(quint32 address, quint8 val) {
 
     return NO_ERROR;
 }
+
+int Cartridge::peek16(quint32 address, quint16& val)
+{
+    const quint8* data = this->hostMemory(address, 2, false);
+
+    // Banked ROM and cartridge RAM are assembled byte by byte
+    if (!data)
+        return IMemory::peek16(address, val);
+
+    val = static_cast<quint16>((data[0] << 8) | data[1]);
+    return NO_ERROR;
+}
+
+int Cartridge::peek32(quint32 address, quint32& val)
+{
+    const quint8* data = this->hostMemory(address, 4, false);
+
+    if (!data)
+        return IMemory::peek32(address, val);
+
+    val = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+    return NO_ERROR;
+}
+
+quint8* Cartridge::hostMemory(quint32 address, quint32 length, bool write)
+{
+    Q_D(Cartridge);
+
+    // Only plain, unbanked ROM can be read directly. Bank switched carts
+    // change their mapping at runtime and go through peek().
+    if (write || !d->header || d->ssfiiBankswitch || d->header->romStart != 0)
+        return nullptr;
+
+    if (address + length - 1 > d->header->romEnd || address + length > static_cast<quint32>(d->romData.length()))
+        return nullptr;
+
+    return reinterpret_cast<quint8*>(d->romData.data()) + address;
+}
@@ -19,6 +19,9 @@ class Cartridge
 
       int      peek(quint32 address, quint8& val);
       int      poke(quint32 address, quint8 val);
+      int      peek16(quint32 address, quint16& val);
+      int      peek32(quint32 address, quint32& val);
+      quint8*  hostMemory(quint32 address, quint32 length, bool write);
 
    signals:
 
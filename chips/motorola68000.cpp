@@ -26,6 +26,7 @@ void Motorola68000::attachBus(MemoryBus* bus)
     Q_D(Motorola68000);
 
     d->bus = bus;
+    d->pages = bus->hostPages();
 }
 
 void Motorola68000::setTracing(bool tracing)
@@ -54,9 +55,14 @@ int Motorola68000::clock(int ticks)
     Q_D(Motorola68000);
 
     d->switchContext();
-    m68k_execute(ticks);
 
-    return 0;
+    return m68k_execute(ticks);
+}
+
+// Cycles executed so far by the running clock() call
+int Motorola68000::cyclesRun() const
+{
+    return m68k_cycles_run();
 }
 
 void Motorola68000::reset()
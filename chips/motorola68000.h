@@ -25,6 +25,7 @@ class Motorola68000 : public QObject
       // Hardware functions
       void  setDisabled(bool disabled);
       int   clock(int ticks);
+      int   cyclesRun() const;
       void  reset();
       void  interruptRequest(Device* device, int level);
       void  clearInterrupt(Device* device, int level);
@@ -12,6 +12,8 @@ Motorola68000Private::Motorola68000Private(Motorola68000* q)
     : disabled(false),
       debug(false),
       debugRun(false),
+      bus(nullptr),
+      pages(nullptr),
       context(nullptr),
       tracing(false),
       q_ptr(q)
@@ -56,38 +58,51 @@ unsigned int m68k_read_memory_8(unsigned int address) {
 
     address = address & 0x00FFFFFF;
 
+    // ROM and RAM pages are read straight from host memory
+    const MemoryHostPage& page = ctx->pages[address >> MEMORY_PAGE_SHIFT];
+    if (Q_LIKELY(page.read))
+        return page.read[address & page.mask];
+
     ctx->bus->peek(address, val);
 
     return val;
 }
 
 unsigned int m68k_read_memory_16(unsigned int address) {
-    quint8 b0, b1 = 0;
     Motorola68000Private* ctx = currentContext;
 
     address = address & 0x00FFFFFF;
 
-    ctx->bus->peek(address,      b0);
-    ctx->bus->peek(address + 1,  b1);
+    const MemoryHostPage& page = ctx->pages[address >> MEMORY_PAGE_SHIFT];
+    if (Q_LIKELY(page.read && (address & page.mask) < page.mask)) {
+        const quint8* data = page.read + (address & page.mask);
+        return static_cast<unsigned int>((data[0] << 8) | data[1]);
+    }
+
+    quint16 val = 0;
+    ctx->bus->peek16(address, val);
 
-    return static_cast<unsigned int>((b0 << 8) | b1);
+    return val;
 }
 
 unsigned int m68k_read_memory_32(unsigned int address) {
-    quint8 b0, b1, b2, b3 = 0;
     Motorola68000Private* ctx = currentContext;
 
     address = address & 0x00FFFFFF;
 
-    ctx->bus->peek(address,      b0);
-    ctx->bus->peek(address + 1,  b1);
-    ctx->bus->peek(address + 2,  b2);
-    ctx->bus->peek(address + 3,  b3);
+    const MemoryHostPage& page = ctx->pages[address >> MEMORY_PAGE_SHIFT];
+    if (Q_LIKELY(page.read && (address & page.mask) + 3 <= page.mask)) {
+        const quint8* data = page.read + (address & page.mask);
+        return  static_cast<unsigned int>(  (data[0] << 24)  |
+                                            (data[1] << 16)  |
+                                            (data[2] << 8)   |
+                                            (data[3] << 0));
+    }
+
+    quint32 val = 0;
+    ctx->bus->peek32(address, val);
 
-    return  static_cast<unsigned int>(  (b0 << 24)  |
-                                        (b1 << 16)  |
-                                        (b2 << 8)   |
-                                        (b3 << 0));
+    return val;
 }
 
 void m68k_write_memory_8(unsigned int address, unsigned int val) {
@@ -95,6 +110,12 @@ void m68k_write_memory_8(unsigned int address, unsigned int val) {
 
     address = address & 0x00FFFFFF;
 
+    const MemoryHostPage& page = ctx->pages[address >> MEMORY_PAGE_SHIFT];
+    if (Q_LIKELY(page.write)) {
+        page.write[address & page.mask] = static_cast<quint8>(val & 0xFF);
+        return;
+    }
+
     // Hack for VDP 8-Bit "Anomaly"
     if  (address >= 0x00C00004 && address <= 0x00C00007) {
         ctx->bus->poke(address & 0x00FFFFFE,        static_cast<quint8>(val & 0xFF));
@@ -109,8 +130,15 @@ void m68k_write_memory_16(unsigned int address, unsigned int val) {
 
     address = address & 0x00FFFFFF;
 
-    ctx->bus->poke(address,     static_cast<quint8>((val >> 8) & 0xFF));
-    ctx->bus->poke(address + 1, static_cast<quint8>(val & 0xFF));
+    const MemoryHostPage& page = ctx->pages[address >> MEMORY_PAGE_SHIFT];
+    if (Q_LIKELY(page.write && (address & page.mask) < page.mask)) {
+        quint8* data = page.write + (address & page.mask);
+        data[0] = static_cast<quint8>((val >> 8) & 0xFF);
+        data[1] = static_cast<quint8>(val & 0xFF);
+        return;
+    }
+
+    ctx->bus->poke16(address, static_cast<quint16>(val & 0xFFFF));
 }
 
 void m68k_write_memory_32(unsigned int address, unsigned int val) {
@@ -118,8 +146,15 @@ void m68k_write_memory_32(unsigned int address, unsigned int val) {
 
     address = address & 0x00FFFFFF;
 
-    ctx->bus->poke(address,     static_cast<quint8>((val >> 24) & 0xFF));
-    ctx->bus->poke(address + 1, static_cast<quint8>((val >> 16) & 0xFF));
-    ctx->bus->poke(address + 2, static_cast<quint8>((val >> 8) & 0xFF));
-    ctx->bus->poke(address + 3, static_cast<quint8>(val & 0xFF));
+    const MemoryHostPage& page = ctx->pages[address >> MEMORY_PAGE_SHIFT];
+    if (Q_LIKELY(page.write && (address & page.mask) + 3 <= page.mask)) {
+        quint8* data = page.write + (address & page.mask);
+        data[0] = static_cast<quint8>((val >> 24) & 0xFF);
+        data[1] = static_cast<quint8>((val >> 16) & 0xFF);
+        data[2] = static_cast<quint8>((val >> 8) & 0xFF);
+        data[3] = static_cast<quint8>(val & 0xFF);
+        return;
+    }
+
+    ctx->bus->poke32(address, val);
 }
@@ -10,6 +10,7 @@
 class Device;
 
 class MemoryBus;
+struct MemoryHostPage;
 class Motorola68000;
 class Motorola68000Private;
 
@@ -23,6 +24,7 @@ public:
     bool                debugRun;
     QList<unsigned int> breakpoins;
     MemoryBus*          bus;
+    const MemoryHostPage* pages;
     void*               context;
 
     bool                tracing;
@@ -0,0 +1,372 @@
+#include "sn76489.h"
+
+#include <math.h>
+
+#include "scheduler.h"
+#include "audiothread.h"
+
+// See http://www.smspower.org/Development/SN76489
+
+// PSG clocks per tick of the channel counters
+#define SN76489_TICK_CYCLES         16
+
+// Master cycles per native YM2612 sample the output is mixed into
+#define SN76489_SAMPLE_CYCLES       (YM2612_DIVIDER * 144)
+
+// Native samples the delta ring holds, power of two
+#define SN76489_DELTA_SIZE          0x1000
+
+// Band-limited step, every delta is spread over this many samples
+#define SN76489_KERNEL_TAPS         16
+#define SN76489_KERNEL_PHASES       256
+
+// Peak amplitude of a single channel, in the units of the mixed 16 bit frames
+#define SN76489_MAX_AMPLITUDE       0x800
+
+// Shift register of the Sega variant, white noise taps bits 0 and 3
+#define SN76489_NOISE_RESET         0x8000
+#define SN76489_NOISE_TAPS          0x0009
+
+enum SN76489Channel {
+    SN76489_TONE_0,
+    SN76489_TONE_1,
+    SN76489_TONE_2,
+    SN76489_NOISE,
+};
+
+enum SN76489NoiseControl {
+    SN76489_NOISE_RATE  = 0x03,
+    SN76489_NOISE_WHITE = 0x04,
+};
+
+class SN76489Private {
+public:
+    AudioThread*    thread;
+
+    // Everything below is only touched by the audio thread
+    quint16     period[3];
+    quint8      attenuation[4];
+    quint8      noiseControl;
+    quint16     noiseShift;
+
+    // Channel and register selected by the last latch byte
+    int         latchChannel;
+    bool        latchVolume;
+
+    // Ticks until the next transition, and the output flip-flop as +1 or -1
+    int         counter[4];
+    int         polarity[4];
+    int         amplitude[4];
+    int         level[4];
+
+    // The noise counter clocks the shift register through its own flip-flop
+    int         noiseFlipFlop;
+
+    // Ticks run so far and PSG clocks short of the next tick
+    quint64     ticks;
+    int         remainder;
+
+    // Level changes at native sample positions, integrated by mix()
+    int         deltas[SN76489_DELTA_SIZE];
+    quint64     readSample;
+    int         integrator;
+
+    qint16      kernel[SN76489_KERNEL_PHASES][SN76489_KERNEL_TAPS];
+    int         volume[16];
+
+public:
+    SN76489Private(SN76489* q)
+        : thread(nullptr),
+          noiseControl(0),
+          noiseShift(SN76489_NOISE_RESET),
+          latchChannel(0),
+          latchVolume(false),
+          noiseFlipFlop(1),
+          ticks(0),
+          remainder(0),
+          readSample(0),
+          integrator(0),
+          q_ptr(q)
+    {
+        memset(this->period, 0, sizeof(this->period));
+        memset(this->deltas, 0, sizeof(this->deltas));
+        memset(this->level, 0, sizeof(this->level));
+
+        for (int c = 0; c < 4; c++) {
+            this->attenuation[c] = 0x0F;
+            this->counter[c] = 1;
+            this->polarity[c] = 1;
+            this->amplitude[c] = 0;
+        }
+
+        // 2 dB per step, the last one is off
+        for (int i = 0; i < 15; i++)
+            this->volume[i] = static_cast<int>(lrint(SN76489_MAX_AMPLITUDE * pow(10.0, -i / 10.0)));
+
+        this->volume[15] = 0;
+
+        this->buildKernel(0.45);
+    }
+
+    // Windowed sinc impulses for each fractional position, integrated into steps by mix()
+    void buildKernel(double cutoff) {
+        const double pi = 3.14159265358979323846;
+
+        for (int phase = 0; phase < SN76489_KERNEL_PHASES; phase++) {
+            double fraction = static_cast<double>(phase) / SN76489_KERNEL_PHASES;
+            double taps[SN76489_KERNEL_TAPS];
+            double sum = 0;
+
+            for (int i = 0; i < SN76489_KERNEL_TAPS; i++) {
+                double x = i - SN76489_KERNEL_TAPS / 2 - fraction;
+                double sinc = x == 0 ? 1.0 : sin(2 * pi * cutoff * x) / (2 * pi * cutoff * x);
+                double window = 0.42 + 0.5 * cos(2 * pi * x / SN76489_KERNEL_TAPS) + 0.08 * cos(4 * pi * x / SN76489_KERNEL_TAPS);
+
+                taps[i] = sinc * window;
+                sum += taps[i];
+            }
+
+            // Every step has to add up to exactly its delta, the rounding error goes to the center
+            int total = 0;
+
+            for (int i = 0; i < SN76489_KERNEL_TAPS; i++) {
+                this->kernel[phase][i] = static_cast<qint16>(lrint(taps[i] / sum * 0x7FFF));
+                total += this->kernel[phase][i];
+            }
+
+            this->kernel[phase][SN76489_KERNEL_TAPS / 2] += 0x7FFF - total;
+        }
+    }
+
+    // Spreads a level change at the given PSG clock over the following samples
+    void addDelta(quint64 cycle, int delta) {
+        quint64 position = (cycle * Z80_DIVIDER << 16) / SN76489_SAMPLE_CYCLES;
+        quint64 sample = position >> 16;
+        int phase = (position >> 8) & (SN76489_KERNEL_PHASES - 1);
+
+        // Keep within the ring, in case mixing runs a little ahead or stalls
+        if (sample < this->readSample) {
+            sample = this->readSample;
+            phase = 0;
+        } else if (sample > this->readSample + SN76489_DELTA_SIZE - SN76489_KERNEL_TAPS) {
+            sample = this->readSample + SN76489_DELTA_SIZE - SN76489_KERNEL_TAPS;
+        }
+
+        const qint16* kernel = this->kernel[phase];
+
+        for (int i = 0; i < SN76489_KERNEL_TAPS; i++)
+            this->deltas[(sample + i) & (SN76489_DELTA_SIZE - 1)] += delta * kernel[i];
+    }
+
+    void updateLevel(int c, quint64 cycle) {
+        int level = this->polarity[c] * this->amplitude[c];
+
+        if (level != this->level[c]) {
+            this->addDelta(cycle, level - this->level[c]);
+            this->level[c] = level;
+        }
+    }
+
+    int noisePeriod() const {
+        int rate = this->noiseControl & SN76489_NOISE_RATE;
+
+        if (rate == SN76489_NOISE_RATE)
+            return qMax<int>(this->period[SN76489_TONE_2], 1);
+
+        return 0x10 << rate;
+    }
+
+    void shiftNoise() {
+        int feedback;
+
+        if (this->noiseControl & SN76489_NOISE_WHITE) {
+            int taps = this->noiseShift & SN76489_NOISE_TAPS;
+            feedback = (taps ^ (taps >> 3)) & 1;
+        } else {
+            feedback = this->noiseShift & 1;
+        }
+
+        this->noiseShift = static_cast<quint16>((this->noiseShift >> 1) | (feedback << 15));
+    }
+
+    // Only transitions cost time, silent or constant channels are skipped
+    void run(int count) {
+        for (int c = SN76489_TONE_0; c <= SN76489_TONE_2; c++) {
+            // Periods of 0 and 1 are above anything audible and hold the output high,
+            // which is how samples are played back through the volume register
+            if (this->period[c] <= 1) {
+                this->polarity[c] = 1;
+                this->updateLevel(c, this->ticks * SN76489_TICK_CYCLES);
+                continue;
+            }
+
+            int t = this->counter[c];
+
+            while (t <= count) {
+                this->polarity[c] = -this->polarity[c];
+
+                if (this->amplitude[c])
+                    this->updateLevel(c, (this->ticks + t) * SN76489_TICK_CYCLES);
+
+                t += this->period[c];
+            }
+
+            this->counter[c] = t - count;
+        }
+
+        int period = this->noisePeriod();
+        int t = this->counter[SN76489_NOISE];
+        int flipFlop = this->noiseFlipFlop;
+
+        // The shift register advances on every other transition of the counter
+        while (t <= count) {
+            flipFlop = -flipFlop;
+
+            if (flipFlop > 0) {
+                this->shiftNoise();
+                this->polarity[SN76489_NOISE] = (this->noiseShift & 1) ? 1 : -1;
+
+                if (this->amplitude[SN76489_NOISE])
+                    this->updateLevel(SN76489_NOISE, (this->ticks + t) * SN76489_TICK_CYCLES);
+            }
+
+            t += period;
+        }
+
+        this->noiseFlipFlop = flipFlop;
+        this->counter[SN76489_NOISE] = t - count;
+        this->ticks += count;
+    }
+
+    quint64 currentCycle() const {
+        return this->ticks * SN76489_TICK_CYCLES + this->remainder;
+    }
+
+    void write(quint8 val) {
+        int channel;
+        int data;
+
+        if (val & 0x80) {
+            this->latchChannel = (val >> 5) & 0x03;
+            this->latchVolume = val & 0x10;
+
+            channel = this->latchChannel;
+            data = val & 0x0F;
+        } else {
+            channel = this->latchChannel;
+            data = val & 0x3F;
+        }
+
+        quint64 cycle = this->currentCycle();
+
+        if (this->latchVolume) {
+            this->attenuation[channel] = data & 0x0F;
+            this->amplitude[channel] = this->volume[this->attenuation[channel]];
+            this->updateLevel(channel, cycle);
+            return;
+        }
+
+        if (channel == SN76489_NOISE) {
+            // Any write restarts the shift register
+            this->noiseControl = data & 0x07;
+            this->noiseShift = SN76489_NOISE_RESET;
+            this->polarity[SN76489_NOISE] = -1;
+            this->updateLevel(SN76489_NOISE, cycle);
+            return;
+        }
+
+        // The new period is loaded once the counter runs out
+        if (val & 0x80)
+            this->period[channel] = (this->period[channel] & 0x3F0) | data;
+        else
+            this->period[channel] = (this->period[channel] & 0x00F) | (data << 4);
+    }
+
+private:
+    SN76489* q_ptr;
+    Q_DECLARE_PUBLIC(SN76489)
+};
+
+SN76489::SN76489(QObject *parent)
+    : QObject(parent),
+      d_ptr(new SN76489Private(this))
+{
+
+}
+
+SN76489::~SN76489()
+{
+    delete this->d_ptr;
+}
+
+int SN76489::peek(quint32 address, quint8 &val)
+{
+    Q_UNUSED(address);
+
+    // Write only
+    val = 0xFF;
+    return NO_ERROR;
+}
+
+int SN76489::poke(quint32 address, quint8 val)
+{
+    Q_D(SN76489);
+
+    // Only the odd byte of each word reaches the chip
+    if (!(address & 0x1))
+        return NO_ERROR;
+
+    if (d->thread)
+        d->thread->write(AudioThread::LOG_PSG, 0, val);
+    else
+        d->write(val);
+
+    return NO_ERROR;
+}
+
+void SN76489::attachAudioThread(AudioThread* thread)
+{
+    Q_D(SN76489);
+
+    d->thread = thread;
+}
+
+void SN76489::write(quint8 val)
+{
+    Q_D(SN76489);
+
+    d->write(val);
+}
+
+void SN76489::clock(int cycles)
+{
+    Q_D(SN76489);
+
+    d->remainder += cycles;
+
+    int ticks = d->remainder / SN76489_TICK_CYCLES;
+    d->remainder %= SN76489_TICK_CYCLES;
+
+    if (ticks > 0)
+        d->run(ticks);
+}
+
+void SN76489::mix(qint16* frames, int count)
+{
+    Q_D(SN76489);
+
+    for (int i = 0; i < count; i++) {
+        int& delta = d->deltas[d->readSample & (SN76489_DELTA_SIZE - 1)];
+
+        // Slightly leaky, so the output settles back to zero like the AC coupled original
+        d->integrator += delta - (d->integrator >> 10);
+        delta = 0;
+
+        d->readSample++;
+
+        int out = d->integrator >> 15;
+
+        frames[i * 2 + 0] = static_cast<qint16>(qBound(-0x8000, frames[i * 2 + 0] + out, 0x7FFF));
+        frames[i * 2 + 1] = static_cast<qint16>(qBound(-0x8000, frames[i * 2 + 1] + out, 0x7FFF));
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef SN76489_H
+#define SN76489_H
+
+#include <QObject>
+#include <memorybus.h>
+
+class AudioThread;
+
+class SN76489Private;
+class SN76489
+        : public QObject,
+        public IMemory
+{
+public:
+    SN76489(QObject* parent = 0);
+    ~SN76489();
+
+    // Emulation
+    int     peek(quint32 address, quint8& val);
+    int     poke(quint32 address, quint8 val);
+
+    // Not owned, writes are passed on to the audio thread, which synthesizes
+    void    attachAudioThread(AudioThread* thread);
+
+    // Synthesis, on the audio thread
+    void    write(quint8 val);
+
+    // Runs for the given amount of PSG clocks (master clock / 15)
+    void    clock(int cycles);
+
+    // Adds the next count mono samples at the native YM2612 rate onto interleaved
+    // stereo frames, the PSG has to be clocked up to the end of them first
+    void    mix(qint16* frames, int count);
+
+private:
+    SN76489Private* d_ptr;
+    Q_DECLARE_PRIVATE(SN76489)
+};
+
+#endif // SN76489_H
@@ -1,84 +1,22 @@
 #include "vdp.h"
 #include "z80.h"
 #include "motorola68000.h"
+#include "scheduler.h"
+#include "videosink.h"
+#include "vdprenderer.h"
+#include "vdprenderthread.h"
 
 #include <QDebug>
 #include <QPainter>
 #include <QtEndian>
 #include <signal.h>
-
-#define VRAM_SIZE 0xFFFF
-#define CRAM_SIZE 0x80
-#define VSRAM_SIZE 0x50
+#include <algorithm>
 
 enum ScreenMode {
     NTSC,
     PAL
 };
 
-enum Register {
-    ModeRegister1     = 0x00,
-    ModeRegister2     = 0x01,
-    PlaneANameTable   = 0x02,
-    WindowNameTable   = 0x03,
-    PlaneBNameTable   = 0x04,
-    SpriteTable       = 0x05,
-    SpritePatternGenerator = 0x06,
-    BackgroundColor   = 0x07,
-    HorizontalInterruptCounter = 0x0A,
-    ModeRegister3     = 0x0B,
-    ModeRegister4     = 0x0C,
-    HScrollData       = 0x0D,
-    NameTablePatternGenerator = 0x0E,
-    AutoIncrementValue = 0x0F,
-    PlaneSize         = 0x10,
-    WindowPlaneHPos   = 0x11,
-    WindowPlaneVPos   = 0x12,
-    DMALength0        = 0x13,
-    DMALength1        = 0x14,
-    DMASource0        = 0x15,
-    DMASource1        = 0x16,
-    DMASource2        = 0x17,
-};
-
-enum ModeRegister1 {
-    MODE1_L     = 0x20,
-    MODE1_IE1   = 0x10,
-    MODE1_INVAL = 0x08,
-    MODE1_PALSEL= 0x04,
-    MODE1_M3    = 0x02,
-    MODE1_DD    = 0x01,
-};
-
-enum ModeRegister2 {
-    MODE2_VRAM  = 0x80,
-    MODE2_DE    = 0x40,
-    MODE2_IE0   = 0x20,
-    MODE2_M1    = 0x10,
-    MODE2_M2    = 0x08,
-    MODE2_M5    = 0x04,
-};
-
-enum ModeRegister3 {
-    MODE3_IE2   = 0x8,
-    MODE3_VS    = 0x4,
-    MODE3_HS    = 0x3,
-    MODE3_HS1   = 0x2,
-    MODE3_HS2   = 0x1,
-};
-
-enum ModeRegister4 {
-    MODE4_RS0   = 0x80,
-    MODE4_VSY   = 0x40,
-    MODE4_HSY   = 0x20,
-    MODE4_SPR   = 0x10,
-    MODE4_SHI   = 0x08,
-    MODE4_LSM   = 0x06,
-    MODE4_LSM1  = 0x04,
-    MODE4_LSM0  = 0x02,
-    MODE4_RS1   = 0x01,
-};
-
 enum VDPCommand {
     NONE = 0,
     PENDING = 1,
@@ -92,37 +30,118 @@ enum VDPCommand {
     CRAM_READ,
 };
 
-enum Plane {
-    PLANEA,
-    PLANEB,
-    WINDOWPLANE,
-};
+// HV counter layout of a display mode
+// According to https://plutiedev.com/mirror/kabuto-hardware-notes#hv-counter
+struct VDPTiming {
+    int hJumpFrom;
+    int hJumpTo;
+    int hInterruptPoint;
+    int hBlankEndPoint;
+    int vCounterPoint;
+
+    int vJumpFrom;
+    int vJumpTo;
+    int vInterruptLine;
+    int vBlankLine;
+
+    // VDP cycles of the pixel at each H counter value
+    quint8 pixelCycles[0x200];
+
+    // Cycles from H counter 0 to each H counter value, and back
+    int     lineCycles;
+    quint16 hPosition[0x200];
+    quint16 hAtPosition[0x400];
+
+    // Next H counter value something happens at and the cycles until then
+    quint16 nextEventH[0x200];
+    quint16 eventCycles[0x200];
+
+    constexpr int nextCounterH(int h) const {
+        return h == this->hJumpFrom ? this->hJumpTo : ((h + 1) & 0x1FF);
+    }
 
-struct SpriteCache {
-    QRect   position;
-    int     entry;
-
-    // Raw sprite data
-    quint16 x;
-    quint16 y;
-    quint8  w;
-    quint8  h;
-    quint8  link;
-    quint8  palette;
-    quint16 pattern;
-
-    bool    priority;
-    bool    vFlip;
-    bool    hFlip;
+    constexpr int nextCounterV(int v) const {
+        return v == this->vJumpFrom ? this->vJumpTo : ((v + 1) & 0x1FF);
+    }
 };
 
-const quint8 MasterSystemLuminance[]    = { 0x00, 0x55, 0xAA, 0xFF };
-const quint8 GenesisLuminance[]         = { 0x00, 0x34, 0x57, 0x74, 0x90, 0xAC, 0xCE, 0xFF };
+constexpr bool vdpTimingEvent(const VDPTiming& timing, int h) {
+    return h == 0x00 ||
+           h == timing.hInterruptPoint ||
+           h == timing.hBlankEndPoint ||
+           h == timing.vCounterPoint;
+}
+
+constexpr VDPTiming vdpBuildTiming(bool h40, bool v30) {
+    VDPTiming timing {};
+
+    timing.hJumpFrom        = h40 ? 0x16C : 0x126;
+    timing.hJumpTo          = h40 ? 0x1C8 : 0x1D2;
+    timing.hInterruptPoint  = h40 ? 0x164 : 0x124;
+    timing.hBlankEndPoint   = h40 ? 0x0A : 0x08;
+    timing.vCounterPoint    = h40 ? 0x148 : 0x108;
+
+    timing.vJumpFrom        = v30 ? 0x10A : 0x102;
+    timing.vJumpTo          = v30 ? 0x1D2 : 0x1CA;
+    timing.vInterruptLine   = v30 ? 0xF0 : 0xE0;
+    timing.vBlankLine       = v30 ? 0xEF : 0xDF;
+
+    for (int h = 0; h < 0x200; h++) {
+        if (h40 && h >= 0xB2 && h < 0xD0)
+            timing.pixelCycles[h] = 3;
+        else if (!h40 && h >= 0x93 && h < 0xB2)
+            timing.pixelCycles[h] = 8;
+        else
+            timing.pixelCycles[h] = 2;
+    }
+
+    // Walk one line of the H counter
+    quint16 sequence[0x200] = {};
+    int count = 0;
+    int position = 0;
+    int h = 0;
+
+    do {
+        sequence[count++] = h;
+        timing.hPosition[h] = position;
+
+        h = timing.nextCounterH(h);
+        position += timing.pixelCycles[h];
+    } while (h != 0);
+
+    timing.lineCycles = position;
+
+    for (int i = 0; i < count; i++) {
+        int end = (i + 1 < count) ? timing.hPosition[sequence[i + 1]] : timing.lineCycles;
+
+        for (int p = timing.hPosition[sequence[i]]; p < end; p++)
+            timing.hAtPosition[p] = sequence[i];
+    }
+
+    // Backwards, so the following pixel is always done already
+    for (int i = count - 1; i >= 0; i--) {
+        int next = sequence[(i + 1) % count];
+
+        timing.eventCycles[sequence[i]] = timing.pixelCycles[next];
+        timing.nextEventH[sequence[i]] = next;
+
+        if (!vdpTimingEvent(timing, next)) {
+            timing.eventCycles[sequence[i]] += timing.eventCycles[next];
+            timing.nextEventH[sequence[i]] = timing.nextEventH[next];
+        }
+    }
+
+    return timing;
+}
+
+// Indexed by [H40][V30]
+constexpr VDPTiming VDPTimings[2][2] = {
+    { vdpBuildTiming(false, false), vdpBuildTiming(false, true) },
+    { vdpBuildTiming(true, false),  vdpBuildTiming(true, true) },
+};
 
 class VDPPrivate {
 public:
-    SDL_Renderer*     renderer;
-
     quint8*             cram;
     quint8*             vram;
     quint8*             vsram;
@@ -131,28 +150,25 @@ public:
     Z80*        z80;
     MemoryBus*  bus;
 
-    quint8      registerData[25];
+    quint8      registerData[REGISTER_COUNT];
     quint8      selectedRegister;
     quint16     addressRegister;
 
     bool fifoEmpty;
     bool fifoFull;
     bool vertialInterruptPending;
-    bool spriteOverflow;
-    bool spriteCollision;
     bool oddFrame;
     bool vBlank;
     bool hBlank;
     bool dmaActive;
     bool writePending;
 
-    bool displayActive;
     bool frameStart;
 
-    bool planeAEnabled;
-    bool planeBEnabled;
-    bool windowPlaneEnabled;
-    bool spritesEnabled;
+    bool renderEnabled;
+    bool frameSkipped;
+    int  spriteLineFirst;
+    int  spriteLineLast;
 
     quint8 command0;
     quint8 command1;
@@ -164,19 +180,13 @@ public:
     quint8 commandByte;
     int   commandData;
 
-    int   screenScanlines;
-    int   screenWidth;
     int   horizontalInterruptCount;
 
-    int   beamH;
     int   beamV;
 
     int   counterH;
     int   counterV;
 
-    int   displayX;
-    int   displayY;
-
     int   currentCycles;
 
     quint16 dmaLength;
@@ -185,6 +195,7 @@ public:
     bool    dmaDataWait;
     bool    dmaStarted;
     bool    dmaFinishedDbg;
+    int     dmaSlots;
     quint16 dmaFillWord;
 
     ScreenMode screenMode;
@@ -194,36 +205,33 @@ public:
     int overscanWidth;
     int overscanHeight;
 
-    int planeWidth;
-    int planeHeight;
+    // Frames are drawn into the sink, the null sink is used if there is none
+    VideoSink*      sink;
+    NullVideoSink   nullSink;
 
-    int planeAScrollX;
-    int planeAScrollY;
-    int planeBScrollX;
-    int planeBScrollY;
+    // Pixels of the locked frame, pitch in pixels
+    quint32*        frameBuffer;
+    int             frameBufferPitch;
+    int             lastRow;
 
-    QVector<QVector<quint32>>   colorCache;
-    QVector<qint16>             scanlineScrollA;
-    QVector<qint16>             scanlineScrollB;
-    QList<SpriteCache>          spriteCache;
+    Scheduler*          scheduler;
+    qint64              clockedCycles;
+    const VDPTiming*    timing;
+    void                (VDPPrivate::*clock)();
+    int                 (VDPPrivate::*nextEvent)() const;
 
-    QImage          spriteBuffer;
-    char*           frameBuffer;
-    quint32*        scanLine;
-
-    SDL_Texture*    frame;
+    VDPRenderer*        lineRenderer;
+    VDPRenderThread*    renderThread;
 
 public:
-    explicit VDPPrivate(VDP* q, SDL_Renderer* renderer)
+    explicit VDPPrivate(VDP* q)
         : q_ptr(q),
           oddFrame(false),
-          renderer(renderer),
-          displayActive(false),
           frameStart(true),
-          planeAEnabled(true),
-          planeBEnabled(true),
-          windowPlaneEnabled(true),
-          spritesEnabled(true),
+          renderEnabled(true),
+          frameSkipped(false),
+          spriteLineFirst(-1),
+          spriteLineLast(-1),
           currentCycles(0),
           dmaLength(0),
           dmaSource(0),
@@ -231,30 +239,22 @@ public:
           dmaDataWait(false),
           dmaStarted(false),
           dmaFinishedDbg(false),
+          dmaSlots(0),
           dmaFillWord(0),
           screenMode(PAL),
           overscanWidth(374),   // 340?
           overscanHeight(312),  // 312?
-          planeAScrollX(0),
-          planeAScrollY(0),
-          planeBScrollX(0),
-          planeBScrollY(0)
+          sink(&nullSink),
+          scheduler(nullptr),
+          clockedCycles(0),
+          renderThread(nullptr)
     {
         this->vram  = static_cast<quint8*>(malloc(VRAM_SIZE));
         this->vsram = static_cast<quint8*>(malloc(VSRAM_SIZE));
         this->cram  = static_cast<quint8*>(malloc(CRAM_SIZE));
 
-        this->frameBuffer       = static_cast<char*>(malloc(sizeof(quint32) * 512 * 512));
-        memset(this->frameBuffer, 0, sizeof(quint32) * 512 * 512);
-
-        this->spriteBuffer = QImage(512, 512, QImage::Format_ARGB32);
-
-        this->frame             = SDL_CreateTexture(this->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,     512,    512);
-        SDL_SetTextureBlendMode(this->frame,            SDL_BLENDMODE_BLEND);
-
-        this->colorCache.resize(4);
-        this->scanlineScrollA.resize(256);
-        this->scanlineScrollB.resize(256);
+        this->lineRenderer = new VDPRenderer(this->vram, this->cram, this->vsram, this->registerData);
+        this->lockFrame();
 
         /*this->frame = QImage(320, 240, QImage::Format_ARGB32);
         this->frame.fill(0x01000000);
@@ -265,129 +265,28 @@ public:
         this->spritePlane = this->frame;*/
     }
 
-    void updateColorCache() {
-        for (int r=0; r < 4; r++) {
-            this->colorCache[r].resize(16);
+    // ======== Frame buffer ========
+    // Lines are drawn straight into the buffer of the sink, unlocking it hands the frame over.
 
-            for (int c=0; c < 16; c++) {
-                this->colorCache[r][c] = this->readColor(r, c);
-            }
-        }
-    }
+    void lockFrame() {
+        this->frameBuffer = this->sink->lockFrame(&this->frameBufferPitch);
+        this->lastRow = 0;
 
-    void updateColorCache(int address) {
-        int row = (address / 2) / 16;
-        int cell = (address / 2) % 16;
+        this->lineRenderer->setFrameBuffer(this->frameBuffer, this->frameBufferPitch);
 
-        this->colorCache[row][cell] = this->readColor(row, cell);
-        this->scanLine[this->beamH] = this->colorCache[row][cell];
+        // Only called while the render thread is fenced
+        if (this->renderThread)
+            this->renderThread->renderer()->setFrameBuffer(this->frameBuffer, this->frameBufferPitch);
     }
 
-    void updateSpriteCache() {
-        int spriteCount = 0;
-
-        quint16 spriteTableAddress = static_cast<quint16>(this->registerData[SpriteTable] << 9);
-        quint16 currentEntry = spriteTableAddress;
-
-        this->spriteBuffer.fill(0);
-        this->spriteCache.clear();
-
-        // Read Sprite Table
-        while(currentEntry && spriteCount < 80) {
-            const quint16* entry = reinterpret_cast<const quint16*>((this->vram + currentEntry));
-
-            quint16 posY = qFromBigEndian(entry[0]) & 0x3FF;
-            quint16 posX = qFromBigEndian(entry[3]) & 0x1FF;
-            quint8 w = ((qFromBigEndian(entry[1]) & 0x0C00) >> 10) + 1;
-            quint8 h = ((qFromBigEndian(entry[1]) & 0x0300) >> 8) + 1;
-            bool hFlip = qFromBigEndian(entry[2]) & 0x800;
-            bool vFlip = qFromBigEndian(entry[2]) & 0x1000;
-            quint16 pattern = (qFromBigEndian(entry[2]) & 0x7FF) << 5;
-            quint8 palette = (qFromBigEndian(entry[2]) & 0x6000) >> 13;
-            quint8 link = qFromBigEndian(entry[1]) & 0x7F;
-            bool priority = qFromBigEndian(entry[2]) & 0x8000;
-
-            /*qDebug() << QString::number(qFromBigEndian(entry[0]), 16).rightJustified(8, '0');
-            qDebug() << QString::number(qFromBigEndian(entry[1]), 16).rightJustified(8, '0');
-            qDebug() << QString::number(qFromBigEndian(entry[2]), 16).rightJustified(8, '0');
-            qDebug() << QString::number(qFromBigEndian(entry[3]), 16).rightJustified(8, '0');*/
-
-            this->spriteCache << SpriteCache{
-                QRect(posX, posY, w * 8, h * 8),
-                (currentEntry - spriteTableAddress) / 8,
-                posX,
-                posY,
-                w,
-                h,
-                link,
-                palette,
-                pattern,
-                priority,
-                vFlip,
-                hFlip
-            };
-
-            spriteCount++;
-
-            if (link)
-                currentEntry = spriteTableAddress + (link * 8);
-            else
-                currentEntry = 0;
-        }
-
-        // Mask Sprites
-        /*QMutableListIterator<SpriteCache> iSprite(this->spriteCache);
-        while(iSprite.hasNext()) {
-            SpriteCache& sprite = iSprite.next();
-            if (sprite.priority && sprite.position.x() == 0) {
-                QMutableListIterator<SpriteCache> iMaskSprite(this->spriteCache);
-
-                while(iMaskSprite.hasNext()) {
-                    SpriteCache& maskSprite = iMaskSprite.next();
-
-                    if ( (maskSprite.entry != sprite.entry) &&
-                         (!maskSprite.priority) &&
-                         (maskSprite.position.top() >= sprite.position.top()) &&
-                         (maskSprite.position.bottom() <= sprite.position.bottom())){
-
-                        iMaskSprite.remove();
-                    }
-                }
-            }
-        }*/
-
-        // Sort by Priority
-        qSort(this->spriteCache.begin(), this->spriteCache.end(), [](const SpriteCache& a, const SpriteCache& b) {
-            return (a.position.top() < b.position.top()) && (a.position.left() < b.position.left()) && (!a.priority && b.priority);
-        });
-
-        // Draw Sprites
-        foreach (const SpriteCache& cache, this->spriteCache) {
-            int posX = cache.x - 128;
-            int posY = cache.y - 128;
+    void unlockFrame() {
+        // Clear the rows no line was drawn to, a locked buffer has no previous contents
+        memset(this->frameBuffer, 0, sizeof(quint32) * FRAMEBUFFER_WIDTH);
 
-            quint16 pattern = cache.pattern;
+        for (int row = this->lastRow + 1; row < FRAMEBUFFER_HEIGHT; row++)
+            memset(this->frameBuffer + row * this->frameBufferPitch, 0, sizeof(quint32) * FRAMEBUFFER_WIDTH);
 
-            for (int x = 0; x < cache.w; x++) {
-                for (int y = 0; y < cache.h; y++) {
-                    int spritePosX = 0;
-                    int spritePosY = 0;
-
-                    if (cache.hFlip)
-                        spritePosX = ((cache.w -1) - x) * 8;
-                    else
-                        spritePosX = x * 8;
-
-                    if (cache.vFlip)
-                        spritePosY = ((cache.h -1) - y) * 8;
-                    else
-                        spritePosY = y * 8;
-
-                    this->blitPattern(&this->spriteBuffer, pattern, cache.palette, cache.priority, cache.hFlip, cache.vFlip, posX + spritePosX, posY + spritePosY);
-                    pattern += 0x20;
-                }
-            }
-        }
+        this->sink->unlockFrame();
     }
 
     void handleCommand(bool force = false) {
@@ -407,7 +306,7 @@ public:
 
             //qDebug() << "VDP Set" << QString::number(this->selectedRegister, 16) << "=" << QString::number(this->command1, 16).rightJustified(2, '0');
 
-            this->registerData[this->selectedRegister] = this->command1;
+            this->writeRegister(this->selectedRegister, this->command1);
         } else {
             //qDebug() << "VDP CMD" << QString::number(this->command0, 16) << QString::number(this->command1, 16);
 
@@ -546,6 +445,211 @@ public:
         }
     }
 
+    // ======== DMA ========
+    // Transfers are bounded by the external access slots of each line and done in blocks.
+
+    // Access slots the VDP has for external transfers on one line
+    inline int dmaLineSlots() const {
+        bool active = !this->vBlank && (this->registerData[ModeRegister2] & MODE2_DE);
+
+        if (this->h40())
+            return active ? 18 : 205;
+
+        return active ? 16 : 167;
+    }
+
+    inline int dmaRemainingSlots() const {
+        int length = this->timing->lineCycles;
+        int position = this->timing->hPosition[this->counterH] - this->timing->hPosition[this->timing->hBlankEndPoint];
+
+        if (position < 0)
+            position += length;
+
+        return this->dmaLineSlots() * (length - position) / length;
+    }
+
+    // VRAM takes a slot per byte, CRAM and VSRAM a slot per word, copies run at half speed
+    inline int dmaUnitCost() const {
+        if (this->dmaType == 0x3)
+            return 4;
+
+        // A fill unit only writes one byte, the first one aside
+        if (this->dmaType == 0x2)
+            return 1;
+
+        return this->command == VRAM_WRITE ? 2 : 1;
+    }
+
+    void runDma() {
+        int cost = this->dmaUnitCost();
+
+        while (this->dmaActive && this->dmaSlots >= cost) {
+            int units = qMin<int>(this->dmaSlots / cost, this->dmaLength ? this->dmaLength : 0x10000);
+            int done = this->dmaBlock(units);
+
+            if (!done) {
+                this->dmaUnit();
+                done = 1;
+            }
+
+            this->dmaSlots -= done * cost;
+            this->dmaStarted = true;
+
+            this->dmaLength -= done;
+            if (!this->dmaLength) {
+                this->command = NONE;
+                this->dmaActive = false;
+                this->dmaStarted = false;
+                this->dmaFinishedDbg = true;
+                this->cpu->setDisabled(false);
+
+                //qDebug() << "ENABLE MOTOROLA";
+            }
+        }
+    }
+
+    // Bulk transfers for the common VRAM cases, returns the number of units done
+    int dmaBlock(int units) {
+        if (this->command != VRAM_WRITE)
+            return 0;
+
+        quint16 address = this->addressRegister;
+        quint8 increment = this->registerData[AutoIncrementValue];
+
+        if (this->dmaType == 0 && increment == 2 && !(address & 0x1) && this->dmaSource <= 0x00FFFFFF) {
+            units = qMin<int>(units, (0x10000 - address) / 2);
+            units = qMin<int>(units, (0x1000000 - this->dmaSource) / 2);
+
+            // Host memory is only handed out within a bus page, the next chunk starts on the following one
+            units = qMin<int>(units, (MEMORY_PAGE_SIZE - (this->dmaSource & MEMORY_PAGE_MASK)) / 2);
+            if (!units)
+                return 0;
+
+            const quint8* source = this->bus->hostMemory(this->dmaSource, units * 2, false);
+            if (!source)
+                return 0;
+
+            this->writeVram(address, source, units * 2);
+
+            this->dmaSource += units * 2;
+            this->addressRegister += units * 2;
+            return units;
+        }
+
+        // Copies run forward a word at a time, a target ahead of the source only takes
+        // words that were not overwritten yet, closer ones repeat and go unit by unit
+        if (this->dmaType == 0x3 && increment == 2) {
+            quint16 source = this->dmaSource & 0xFFFF;
+
+            units = qMin<int>(units, (0x10000 - address) / 2);
+            units = qMin<int>(units, (0x10000 - source) / 2);
+
+            if (address > source)
+                units = qMin<int>(units, (address - source) / 2);
+
+            if (!units)
+                return 0;
+
+            this->copyVram(address, source, units * 2);
+
+            this->dmaSource = source + units * 2;
+            this->addressRegister += units * 2;
+            return units;
+        }
+
+        // The first fill unit also writes the low byte
+        if (this->dmaType == 0x2 && increment == 1 && this->dmaStarted) {
+            units = qMin<int>(units, 0xFFFF - address);
+            if (!units)
+                return 0;
+
+            this->fillVram(address + 1, (this->dmaFillWord >> 8) & 0xFF, units);
+
+            this->addressRegister += units;
+            return units;
+        }
+
+        return 0;
+    }
+
+    void dmaUnit() {
+        quint8* target = nullptr;
+        quint16 mask = 0;
+
+        switch(this->command) {
+        case VSRAM_WRITE:
+            target = reinterpret_cast<quint8*>(this->vsram);
+            mask = 0x3F;
+            break;
+
+        case CRAM_WRITE:
+            target = reinterpret_cast<quint8*>(this->cram);
+            mask = 0x7F;
+            break;
+
+        case VRAM_WRITE:
+            target = reinterpret_cast<quint8*>(this->vram);
+            mask = 0xFFFF;
+            break;
+
+        default:
+            qDebug() << "Invalid DMA Command" << this->command;
+            break;
+        }
+
+        // Only perform DMA if we have valid information
+        if (target) {
+            if (    (this->command != VSRAM_WRITE && this->command != CRAM_WRITE) ||
+                    (this->command == VSRAM_WRITE && this->addressRegister <= 0x3F) ||
+                    (this->command == CRAM_WRITE && this->addressRegister <= 0x7F)) {
+
+                this->addressRegister &= mask;
+
+                if (this->dmaType == 0) { // DMA WRITE
+                    quint16 word = 0;
+
+                    if (this->dmaSource > 0x00FFFFFF) {
+                        this->dmaSource &= 0x0000FFFF;
+                        this->dmaSource |= 0xE00000;
+                    }
+
+                    this->bus->peek16(this->dmaSource, word);
+
+                    quint8 b0 = static_cast<quint8>(word >> 8);
+                    quint8 b1 = static_cast<quint8>(word & 0xFF);
+
+                    if (this->command == VRAM_WRITE && (this->addressRegister & 0x1)) {
+                        this->writeTarget((this->addressRegister & 0xFFFE),       b1);
+                        this->writeTarget((this->addressRegister & 0xFFFE) + 1,   b0);
+                    } else {
+                        this->writeTarget(this->addressRegister & 0xFFFE,         b0);
+                        this->writeTarget((this->addressRegister & 0xFFFE) + 1,   b1);
+                    }
+
+                    this->dmaSource += 2;
+                } else if (this->dmaType == 0x2) { // DMA FILL
+                    if (!this->dmaStarted && this->command == VRAM_WRITE)
+                        this->writeTarget(this->addressRegister, this->dmaFillWord & 0xFF);
+                    else if (this->command != VRAM_WRITE)
+                        this->writeTarget(this->addressRegister, this->dmaFillWord & 0xFF);
+
+                    this->writeTarget(this->addressRegister + 1, (this->dmaFillWord >> 8) & 0xFF);
+                } else if (this->dmaType == 0x3) { // DMA COPY
+                    this->dmaSource &= mask;
+
+                    this->writeTarget(this->addressRegister,       target[this->dmaSource]);
+                    this->writeTarget(this->addressRegister + 1,   target[this->dmaSource + 1]);
+
+                    this->dmaSource += 2;
+                }
+            } else {
+                this->dmaLength = 1;
+            }
+
+            this->addressRegister += this->registerData[AutoIncrementValue];
+        }
+    }
+
     void performDirectWrite(quint16 data) {
         if (this->dmaType == 0x2) {
             //qDebug() << "Fill DWORD" << QString::number(data, 16).rightJustified(4, '0');
@@ -560,10 +664,8 @@ public:
             switch (this->command) {
             case CRAM_WRITE:
             {
-                this->cram[(this->addressRegister & 0x7F)] = static_cast<char>(data & 0x00FF);
-                this->cram[(this->addressRegister + 1) & 0x7F] = static_cast<char>((data & 0xFF00) >> 8);
-
-                this->updateColorCache(this->addressRegister);
+                this->writeCram(this->addressRegister, data & 0x00FF);
+                this->writeCram(this->addressRegister + 1, (data & 0xFF00) >> 8);
 
                 this->addressRegister += this->registerData[AutoIncrementValue];
                 break;
@@ -571,8 +673,8 @@ public:
 
             case VRAM_WRITE:
             {
-                this->vram[this->addressRegister & 0xFFFF] = static_cast<char>(data & 0x00FF);
-                this->vram[(this->addressRegister + 1) & 0xFFFF] = static_cast<char>((data & 0xFF00) >> 8);
+                this->writeVram(this->addressRegister, data & 0x00FF);
+                this->writeVram(this->addressRegister + 1, (data & 0xFF00) >> 8);
                 this->addressRegister += this->registerData[AutoIncrementValue];
                 break;
             }
@@ -582,8 +684,8 @@ public:
                 this->addressRegister &= 0x7F;
 
                 if(this->addressRegister < 0x4F) {
-                    this->vsram[this->addressRegister] = static_cast<char>(data & 0x00FF);
-                    this->vsram[this->addressRegister + 1] = static_cast<char>((data & 0xFF00) >> 8);
+                    this->writeVsram(this->addressRegister, data & 0x00FF);
+                    this->writeVsram(this->addressRegister + 1, (data & 0xFF00) >> 8);
                 }
 
                 this->addressRegister += this->registerData[AutoIncrementValue];
@@ -597,659 +699,463 @@ public:
         }
     }
 
-    void drawFrame() {
-
-    }
-
-    inline quint32 readColor(quint8 index) const {
-        return this->readColor((index & 0x30) >> 4, (index & 0xF));
-    }
+    quint8* dataPortTarget(int* mask) const {
+        switch(this->command) {
+        case VSRAM_READ:
+        case VSRAM_WRITE:
+            *mask = 0x7F;
+            return this->vsram;
 
-    inline quint32 readColor(int row, int cell) const {
-        int address = (row * 16 + cell) << 1;
-        quint8 b0, b1;
+        case CRAM_READ:
+        case CRAM_WRITE:
+            *mask = 0x7F;
+            return this->cram;
 
-        b0 = this->cram[address];
-        b1 = this->cram[address + 1];
+        case VRAM_READ:
+        case VRAM_WRITE:
+            *mask = 0xFFFF;
+            return this->vram;
 
-        return this->decodeColor(b0, b1) & (cell == 0 ? 0x00FFFFFF : 0xFFFFFFFF);
+        default:
+            return nullptr;
+        }
     }
 
-    inline quint32 decodeColor(quint8 b0, quint8 b1) const {
-        quint32 b, g, r;
+    // ======== Counter timing ========
 
-        if (this->registerData[ModeRegister1] & MODE1_PALSEL) {
-            b = GenesisLuminance[(b0 & 0x0E) >> 1];
-            g = GenesisLuminance[(b1 & 0xE0) >> 5];
-            r = GenesisLuminance[(b1 & 0x0E) >> 1];
-        } else {
-            b = MasterSystemLuminance[(b0 & 0x02) >> 1];
-            g = MasterSystemLuminance[(b1 & 0x20) >> 5];
-            r = MasterSystemLuminance[(b1 & 0x02) >> 1];
-        }
-
-        return 0xFF000000 | (r << 16) | (g << 8) | b;
+    inline bool h40() const {
+        return this->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1);
     }
 
-    qint16 decodeDisplayScroll(quint16 val) const {
-        val = qFromBigEndian(val);
-
-        return static_cast<qint16>((val & 0x1FF) | (val & 0x200 ? 0x8000 : 0));
+    inline bool v30() const {
+        return this->registerData[ModeRegister2] & MODE2_M2;
     }
 
-    void blitPattern(QImage* buffer, quint16 address, int palette, bool priority, bool flipH, bool flipV, int dstX, int dstY, bool debug = false) const {
-        address &= 0xFFFF;
+    // ======== Display loop ========
+    // Instantiated for every display mode, the mode registers select the instantiation.
 
-        const quint8* pattern = reinterpret_cast<const quint8*>(this->vram + address);
+    template<bool H40, bool V30>
+    void clockMode() {
+        Q_Q(VDP);
 
-        for (int y=0; y < 8; y++) {
-            int pY = flipV ? 7 - y : y;
-            int tY = dstY + y;
+        constexpr const VDPTiming& T = VDPTimings[H40][V30];
 
-            if (tY < 0 || tY >= buffer->height())
-                continue;
+        bool interruptFired = false;
 
-            quint32* scanline = reinterpret_cast<quint32*>(buffer->scanLine(tY));
+        while(this->currentCycles < 0 && !interruptFired) {
+            //} else {
+            //   this->cpu->setDisabled(false);
+            //}
 
-            for (int x=0; x < 8; x++) {
-                int pX = flipH ? 7 - x : x;
-                int tX = dstX + x;
+            // Check if display is enabled
+            //if (this->registerData[ModeRegister1] & MODE1_DE) {
+            if (this->frameStart) { //(this->beamV == 0 && this->beamH == 0) {
+                this->frameStart = false;
+                this->oddFrame = !this->oddFrame;
 
-                if (tX < 0 || tX >= buffer->width())
-                    continue;
+                if (q->interruptPending())
+                    q->clearInterrupt();
 
-                quint32 color;
-                if (pX & 0x1)
-                    color = this->colorCache[palette][pattern[(pY * 4) + (pX / 2)] & 0x0F];
-                else
-                    color = this->colorCache[palette][(pattern[(pY * 4) + (pX / 2)] & 0xF0) >> 4];
+                if (this->dmaFinishedDbg) {
+                    emit q->dmaFinished();
+                    this->dmaFinishedDbg = false;
+                }
 
-                if (!(color & 0xFF000000))
-                    continue;
+                this->vertialInterruptPending = false;
+                this->horizontalInterruptCount = this->registerData[HorizontalInterruptCounter];
+                 //this->readColor(this->registerData[BackgroundColor]));
 
-                if (debug) {
-                    scanline[tX] = color;
-                } else {
-                    color &= 0x00FFFFFF;
+                // Skipped frames leave the frame locked as it is
+                if (!this->frameSkipped) {
+                    // Wait for the render thread to finish the previous frame
+                    if (this->renderThread)
+                        this->renderThread->fence();
 
-                    if (scanline[tX] & 0xFF000000) {
-                        if (priority)
-                            scanline[tX] = color | 0xB0000000; // Set priority and collision bit
-                        else
-                            scanline[tX] |= 0x20000000; // Set collision bit
-                    } else {
-                        scanline[tX] = color | (priority ? 0x90000000 : 0x10000000);
-                    }
+                    this->unlockFrame();
+                    emit q->frameUpdated(this->sink->frame());
+                    this->lockFrame();
                 }
-            }
-        }
-    }
 
-    inline void tracePlane(int plane, int x, int y, quint32* color, bool* priority) {
-        int baseAddress = 0;
-        int planePixelW, planePixelH;
-        int tileX, tileY, subtileX, subtileY;
-
-        int patternW, patternH, factor;
-        patternW = 8;
-
-        if (this->registerData[ModeRegister4] & MODE4_LSM) {
-            patternH = 16;
-            factor = 2;
-        } else {
-            patternH = 8;
-            factor = 1;
-        }
+                emit q->frameStarted();
 
-        switch (plane) {
-        case PLANEA:
-            baseAddress = (this->registerData[PlaneANameTable] & 0x38) << 10;
-            break;
+                this->frameSkipped = !this->renderEnabled;
+                this->spriteLineFirst = -1;
 
-        case PLANEB:
-            baseAddress = (this->registerData[PlaneBNameTable] & 0x7) << 13;
-            break;
+                //qDebug() << "Frame Start";
 
-        default:
-            return;
-        }
+                /*if(this->registerData[ModeRegister2] & MODE2_M2)
+                    this->screenScanlines = 30 * 8;
+                else
+                    this->screenScanlines = 28 * 8;
 
-        // Compute tile coordinates
-        planePixelW = this->planeWidth * patternW;
-        planePixelH = this->planeHeight * patternH;
+                if(this->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1))
+                    this->screenWidth = 40 * 8;
+                else
+                    this->screenWidth = 32 * 8;*/
 
-        subtileX = x % planePixelW;
-        subtileY = y % planePixelH;
+                //this->beamH = 0;
 
-        if (subtileX < 0)
-            subtileX += planePixelW;
+                // ======== Update internal registers ========
 
-        if (subtileY < 0)
-            subtileY += planePixelH;
+                //this->updateColorCache();
 
-        tileX = subtileX / patternW;
-        tileY = subtileY / patternH;
+                // Screen resolution and background size are latched for the whole frame
+                this->lineRenderer->frameStart();
 
-        subtileX %= patternW;
-        subtileY %= patternH;
+                if (this->renderThread)
+                    this->renderThread->frameStart();
+            }
 
+            // According to https://plutiedev.com/mirror/kabuto-hardware-notes#hv-counter
+            if (this->counterH == T.hInterruptPoint) {
 
-        // Read tile
-        const quint16* nametable = reinterpret_cast<const quint16*>(this->vram + baseAddress);
-        quint16 entry = qFromBigEndian(nametable[tileY * this->planeWidth + tileX]);
+                this->horizontalInterruptCount--;
 
-        quint16 artIndex = (entry & 0x7FF) << 5;
-        quint8  palette = (entry & 0x6000) >> 13;
-        *priority = !!(entry & 0x8000);
+                if (this->horizontalInterruptCount < 0) {
+                    if (this->registerData[ModeRegister1] & MODE1_IE1) {
+                        q->interruptRequest(4);
+                        //this->currentCycles = 0;
+                    }
+                }
 
-        // Horizontal Flip
-        if (entry & 0x800)
-            subtileX = (patternW - 1) - subtileX;
+                this->hBlank = true;
+                //interruptFired = true;
+            }
 
-        // Vertical Flip
-        if (entry & 0x1000)
-            subtileY = (patternH - 1) - subtileY;
+            if (this->counterH == T.hBlankEndPoint) {
 
-        // Divide by interlace factor
-        subtileY /= factor;
+                this->horizontalInterruptCount = this->registerData[HorizontalInterruptCounter];
 
-        // Read pattern
-        const quint8* pattern = reinterpret_cast<const quint8*>(this->vram + (artIndex & 0xFFF8));
+                this->hBlank = false;
+                //this->beamH = 0;
+                this->beamV++;
 
-        if (subtileX % 2)
-            *color = this->colorCache[palette][(pattern[subtileY * 4 + subtileX / 2] & 0x0F)];
-        else
-            *color = this->colorCache[palette][(pattern[subtileY * 4 + subtileX / 2] & 0xF0) >> 4];
-    }
+                this->dmaSlots = this->dmaLineSlots();
 
-    inline void traceSprites(int x, int y, quint32* color, bool* priority) {
-        const quint32* spritePixels = reinterpret_cast<const quint32*>(this->spriteBuffer.constBits());
-        quint32 bufferPixel = spritePixels[y * 512 + x];
+                // Draw the whole line as its active display starts
+                if (this->frameSkipped) {
+                    if (!this->vBlank)
+                        this->skipLine(this->counterV);
+                } else if (this->beamV < FRAMEBUFFER_HEIGHT) {
+                    if (this->renderThread)
+                        this->renderThread->line(this->beamV, this->counterV, this->vBlank);
+                    else
+                        this->lineRenderer->renderLine(this->beamV, this->counterV, this->vBlank);
 
-        if (bufferPixel & 0xFF000000) {
-            *color = bufferPixel | 0xFF000000;
-            *priority = (bufferPixel & 0x80000000);
-        }
-    }
+                    this->lastRow = this->beamV;
+                }
 
-    inline quint32 tracePixel(int x, int y) {
-        if (!this->displayActive || x >= this->screenWidth || y >= this->screenScanlines)
-            return 0xFF000000;
+                //this->updateColorCache();
+            }
 
-        quint32 bgColor = this->colorCache[(this->registerData[BackgroundColor] & 0x30) >> 4]
-                                          [this->registerData[BackgroundColor] & 0xF] | 0xFF000000;
+            if (this->counterV == T.vInterruptLine && this->counterH == 0x00) {
 
-        quint32 mixColor = bgColor;
-        quint32 planeAColor = 0;
-        quint32 planeBColor = 0;
-        quint32 spriteColor = 0;
+                this->vertialInterruptPending = true;
 
-        bool planeAPriority = false;
-        bool planeBPriority = false;
-        bool spritePriority = false;
+                if (this->registerData[ModeRegister2] & MODE2_IE0) {
+                    //qDebug() << "VBLANK";
 
-        int displayOffsetX = 0;
-        int displayOffsetY = 0;
+                    q->interruptRequest(6);
+                    //this->currentCycles = 0;
+                }
 
-        /*if (this->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1))
-            displayOffsetX = 5;
-        else
-            displayOffsetX = 4;*/
+                this->z80->interrupt();
+            }
 
-        int planeAX = x - displayOffsetX, planeAY = y - displayOffsetY;
-        int planeBX = x - displayOffsetX, planeBY = y - displayOffsetY;
+            if (this->counterH == T.vCounterPoint) {
+                if (this->counterV == T.vBlankLine) {
+                    //this->z80->interrupt();
+                    this->vBlank = true;
+                    //interruptFired = true;
+                }
 
-        const quint16* hScrollData = reinterpret_cast<const quint16*>(this->vram + ((this->registerData[HScrollData] & 0x3F) << 10));
-        const quint16* vScrollData = reinterpret_cast<const quint16*>(this->vsram);
+                if (this->counterV == 0x1FE) {
+                    this->vBlank = false;
+                    this->beamV = 0;
+                    this->frameStart = true;
+                }
 
-        switch (this->registerData[ModeRegister3] & MODE3_HS) {
-        case 0x00:
-            planeAX = x - this->planeAScrollX;
-            planeBX = x - this->planeBScrollX;
-            break;
+                this->counterV = T.nextCounterV(this->counterV);
+            }
 
-        case 0x02:
-            planeAX = x - this->decodeDisplayScroll(hScrollData[(y/8) * 16 ]);
-            planeBX = x - this->decodeDisplayScroll(hScrollData[(y/8) * 16 + 1]);
-            break;
+            /*if (this->beamH > this->overscanWidth) {
+                this->beamH = 0;
+                this->beamV++;
 
-        case 0x03:
-            planeAX = x - this->decodeDisplayScroll(hScrollData[y * 2]);
-            planeBX = x - this->decodeDisplayScroll(hScrollData[y * 2 + 1]);
-            break;
-        }
+                this->updateColorCache();
+                //this->hBlank = false;
+            }*/
 
-        switch (this->registerData[ModeRegister3] & MODE3_VS) {
-        case 0x00:
-            planeAY = y - this->planeAScrollY;
-            planeBY = y - this->planeBScrollY;
-            break;
+            /*if (this->beamH < this->screenWidth &&
+                this->beamV < this->screenScanlines &&
+                (this->registerData[ModeRegister2] & MODE2_DE) &&
+                (((this->registerData[ModeRegister1] & MODE1_L) && (this->beamH < 30)) || !(this->registerData[ModeRegister1] & MODE1_L)))
+                this->displayActive = true;
+            else
+                this->displayActive = false;*/
 
-        case 0x01:
-            planeAY = y - this->decodeDisplayScroll(vScrollData[(x/16) * 2]);
-            planeBY = y - this->decodeDisplayScroll(vScrollData[(x/16) * 2 + 1]);
-        }
+            if (this->dmaActive && !this->dmaDataWait) {
+                // A transfer starting mid-line only gets the slots left on this line
+                if (!this->dmaStarted)
+                    this->dmaSlots = this->dmaRemainingSlots();
 
-        if (this->planeAEnabled)
-            this->tracePlane(PLANEA, planeAX, planeAY, &planeAColor, &planeAPriority);
+                this->runDma();
+            }
 
-        if (this->planeBEnabled)
-            this->tracePlane(PLANEB, planeBX, planeBY, &planeBColor, &planeBPriority);
+            // Nothing happens between the event points, skip right to the next one
+            this->currentCycles += T.eventCycles[this->counterH];
+            this->counterH = T.nextEventH[this->counterH];
 
-        if (this->spritesEnabled)
-            this->traceSprites(x - displayOffsetX, y - displayOffsetY, &spriteColor, &spritePriority);
+            /*if (this->beamV >= this->overscanHeight) {
+                this->beamV = 0;
+                this->beamH = 0;
 
-        if ((planeBColor & 0xFF000000) && !planeBPriority)
-            mixColor = planeBColor;
+                //this->vBlank = false;
+                this->oddFrame = !this->oddFrame;
+            }*/
 
-        if ((planeAColor & 0xFF000000) && !planeAPriority)
-            mixColor = planeAColor;
+            //}
+        }
+    }
 
-        if ((spriteColor & 0xFF000000) && !spritePriority)
-            mixColor = spriteColor;
+    template<bool H40, bool V30>
+    int nextEventMode() const {
+        constexpr const VDPTiming& T = VDPTimings[H40][V30];
 
-        if ((planeBColor & 0xFF000000) && planeBPriority)
-            mixColor = planeBColor;
+        int cycles = this->currentCycles;
+        int h = this->counterH;
+        int v = this->counterV;
 
-        if ((planeAColor & 0xFF000000) && planeAPriority)
-            mixColor = planeAColor;
+        // Walk the event points up to the next one where an interrupt can be raised
+        while (h != T.hInterruptPoint && !(h == 0x00 && v == T.vInterruptLine)) {
+            if (h == T.vCounterPoint)
+                v = T.nextCounterV(v);
 
-        if ((spriteColor & 0xFF000000) && spritePriority)
-            mixColor = spriteColor;
+            cycles += T.eventCycles[h];
+            h = T.nextEventH[h];
+        }
 
-        return mixColor;
+        return cycles + 1;
     }
 
-private:
-    VDP* q_ptr;
-    Q_DECLARE_PUBLIC(VDP)
-};
+    // Counters at the current master cycle, the display loop itself only stops at event points
+    void currentCounters(int* h, int* v, bool* hBlank, bool* vBlank) const {
+        const VDPTiming& T = *this->timing;
 
-VDP::VDP(SDL_Renderer *renderer, QObject *parent)
-    : QObject(parent),
-      Device(),
-      d_ptr(new VDPPrivate(this, renderer))
-{
-    this->reset();
-}
+        int elapsed = 0;
 
-VDP::~VDP()
-{
-    delete d_ptr;
-}
+        if (this->scheduler)
+            elapsed = static_cast<int>(this->scheduler->now() / VDP_DIVIDER - (this->clockedCycles + this->currentCycles));
 
-void VDP::attachBus(MemoryBus* bus)
-{
-    Q_D(VDP);
+        int position = T.hPosition[this->counterH] + elapsed;
+        int counterV = this->counterV;
 
-    d->bus = bus;
-}
+        // The V counter steps whenever the V counter point is passed, the next event is still pending
+        int vPoint = T.hPosition[T.vCounterPoint];
+        if (vPoint < T.hPosition[this->counterH])
+            vPoint += T.lineCycles;
 
-MemoryBus* VDP::bus() const
-{
-    Q_D(const VDP);
+        for (; vPoint <= position; vPoint += T.lineCycles)
+            counterV = T.nextCounterV(counterV);
 
-    return d->bus;
-}
-
-int VDP::clock(int cycles)
-{
-    Q_D(VDP);
-
-    d->currentCycles -= cycles;
+        int linePosition = (position % T.lineCycles + T.lineCycles) % T.lineCycles;
 
-    bool interruptFired = false;
-
-    while(d->currentCycles < 0 && !interruptFired) {
-        //} else {
-        //   d->cpu->setDisabled(false);
-        //}
-
-        // Check if display is enabled
-        //if (d->registerData[ModeRegister1] & MODE1_DE) {
-        if (d->frameStart) { //(d->beamV == 0 && d->beamH == 0) {
-            d->frameStart = false;
-            d->oddFrame != d->oddFrame;
+        *h = T.hAtPosition[linePosition];
+        *v = counterV;
+        *hBlank = linePosition >= T.hPosition[T.hInterruptPoint] || linePosition < T.hPosition[T.hBlankEndPoint];
+        *vBlank = counterV > T.vBlankLine && counterV != 0x1FF;
+    }
 
-            if (this->interruptPending())
-                this->clearInterrupt();
+    void updateTiming() {
+        static void (VDPPrivate::* const clockModes[2][2])() = {
+            { &VDPPrivate::clockMode<false, false>,   &VDPPrivate::clockMode<false, true> },
+            { &VDPPrivate::clockMode<true, false>,    &VDPPrivate::clockMode<true, true> },
+        };
 
-            if (d->dmaFinishedDbg) {
-                emit this->dmaFinished();
-                d->dmaFinishedDbg = false;
-            }
+        static int (VDPPrivate::* const nextEventModes[2][2])() const = {
+            { &VDPPrivate::nextEventMode<false, false>,   &VDPPrivate::nextEventMode<false, true> },
+            { &VDPPrivate::nextEventMode<true, false>,    &VDPPrivate::nextEventMode<true, true> },
+        };
 
-            d->vertialInterruptPending = false;
-            d->horizontalInterruptCount = d->registerData[HorizontalInterruptCounter];
-             //d->readColor(d->registerData[BackgroundColor]));
+        bool h40 = this->h40();
+        bool v30 = this->v30();
 
-            SDL_UpdateTexture(d->frame, nullptr, d->frameBuffer, sizeof(quint32) * 512);
-            emit this->frameUpdated(d->frame);
+        this->timing = &VDPTimings[h40][v30];
+        this->clock = clockModes[h40][v30];
+        this->nextEvent = nextEventModes[h40][v30];
+    }
 
-            memset(d->frameBuffer, 0, sizeof(quint32) * 512 * 512);
+    void drawFrame() {
 
-            //qDebug() << "Frame Start";
+    }
 
-            /*if(d->registerData[ModeRegister2] & MODE2_M2)
-                d->screenScanlines = 30 * 8;
-            else
-                d->screenScanlines = 28 * 8;
+    // ======== Memory writes ========
+    // Every write also reaches the renderers, the direct one keeps its caches up to date
+    // and the render thread replays it into its own copy of the memory.
 
-            if(d->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1))
-                d->screenWidth = 40 * 8;
-            else
-                d->screenWidth = 32 * 8;*/
+    inline void writeVram(quint16 address, quint8 value) {
+        this->lineRenderer->writeVram(address, value);
 
-            //d->beamH = 0;
+        if (this->renderThread)
+            this->renderThread->write(VDPRenderThread::LOG_VRAM, address, value);
+    }
 
-            // ======== Update internal registers ========
+    inline void writeVram(quint16 address, const quint8* data, int length) {
+        this->lineRenderer->writeVram(address, data, length);
 
-            //d->updateColorCache();
+        if (this->renderThread) {
+            for (int i = 0; i < length; i++)
+                this->renderThread->write(VDPRenderThread::LOG_VRAM, address + i, data[i]);
+        }
+    }
 
-            // Screen resolution
-            d->screenScanlines  = (d->registerData[ModeRegister2] & MODE2_M2) ? 240 : 224;
-            d->screenWidth      = ((d->registerData[ModeRegister4] & MODE4_RS0) && (d->registerData[ModeRegister4] & MODE4_RS1)) ? 320 : 256;
+    inline void fillVram(quint16 address, quint8 value, int length) {
+        this->lineRenderer->fillVram(address, value, length);
 
-            // Background size
-            switch ((d->registerData[PlaneSize] & 0x30) >> 4) {
-            case 0x02:
-            case 0x00: d->planeHeight = 32; break;
-            case 0x01: d->planeHeight = 64; break;
-            case 0x03: d->planeHeight = 128; break;
-            }
+        if (this->renderThread) {
+            for (int i = 0; i < length; i++)
+                this->renderThread->write(VDPRenderThread::LOG_VRAM, address + i, value);
+        }
+    }
 
-            switch ((d->registerData[PlaneSize] & 0x03)) {
-            case 0x02:
-            case 0x00: d->planeWidth = 32; break;
-            case 0x01: d->planeWidth = 64; break;
-            case 0x03: d->planeWidth = 128; break;
-            }
+    // Hands the layer toggles of the line renderer on to the render thread
+    void updateLayers() {
+        if (!this->renderThread)
+            return;
 
-            // Sprites
-            d->updateSpriteCache();
+        this->renderThread->setLayers(this->lineRenderer->planeAEnabled,
+                                      this->lineRenderer->planeBEnabled,
+                                      this->lineRenderer->windowPlaneEnabled,
+                                      this->lineRenderer->spritesEnabled);
+    }
 
-            // Scrolling
-            d->scanlineScrollA.fill(0);
-            d->scanlineScrollB.fill(0);
+    inline void copyVram(quint16 address, quint16 source, int length) {
+        this->lineRenderer->copyVram(address, source, length);
 
-            d->displayX = 0;
-            d->displayY = 0;
+        if (this->renderThread) {
+            for (int i = 0; i < length; i++)
+                this->renderThread->write(VDPRenderThread::LOG_VRAM, address + i, this->vram[address + i]);
         }
+    }
 
-        //if (d->beamH == 0) {
-            d->planeAScrollY = 0;
-            d->planeBScrollY = 0;
-
-            d->planeAScrollX = 0;
-            d->planeBScrollX = 0;
+    inline void writeCram(quint8 address, quint8 value) {
+        address &= (CRAM_SIZE - 1);
 
-            if (!(d->registerData[ModeRegister3] & MODE3_VS)) {
-                const quint16* scrollData = reinterpret_cast<const quint16*>(d->vsram);
+        this->lineRenderer->writeCram(address, value);
 
-                d->planeAScrollY = d->decodeDisplayScroll(scrollData[0]) * -1;
-                d->planeBScrollY = d->decodeDisplayScroll(scrollData[1]) * -1;
-            }
+        if (this->renderThread)
+            this->renderThread->write(VDPRenderThread::LOG_CRAM, address, value);
+    }
 
-            if(!(d->registerData[ModeRegister3] & MODE3_HS)) {
-                const quint16* scrollData = reinterpret_cast<const quint16*>(d->vram + ((d->registerData[HScrollData] & 0x3F) << 10));
+    inline void writeVsram(quint8 address, quint8 value) {
+        if (address >= VSRAM_SIZE)
+            return;
 
-                d->planeAScrollX = d->decodeDisplayScroll(scrollData[0]);
-                d->planeBScrollX = d->decodeDisplayScroll(scrollData[1]);
-            }
-        //}
+        this->lineRenderer->writeVsram(address, value);
 
-        d->displayActive = !(d->vBlank || d->hBlank) && (d->registerData[ModeRegister2] & MODE2_DE);
+        if (this->renderThread)
+            this->renderThread->write(VDPRenderThread::LOG_VSRAM, address, value);
+    }
 
-        // Update current Scanline
-        d->scanLine = reinterpret_cast<quint32*>(static_cast<char*>(d->frameBuffer) + (d->beamV * (sizeof(quint32) * 512)));
+    inline void writeRegister(quint8 reg, quint8 value) {
+        this->lineRenderer->writeRegister(reg, value);
 
-        if (d->displayActive) {
-            d->displayY = d->counterV;
+        if (reg == ModeRegister2 || reg == ModeRegister4)
+            this->updateTiming();
 
-            d->scanLine[d->beamH] = d->tracePixel(d->displayX, d->displayY);
+        if (this->renderThread)
+            this->renderThread->write(VDPRenderThread::LOG_REGISTER, reg, value);
+    }
 
-            d->displayX++;
-        } else if (d->vBlank) {
-            //if (d->beamH == 0) {
-                //for(int i = d->counterH; i < 512; i++)
-            if (!(d->scanLine[d->beamH] & 0x00FFFFFF))
-                d->scanLine[d->beamH] = 0xFF888800;
-            //}
-        } else if (d->hBlank) {
-            if (!(d->scanLine[d->beamH] & 0x00FFFFFF))
-                d->scanLine[d->beamH] = 0xFF888800;
+    inline void writeTarget(quint16 address, quint8 value) {
+        switch (this->command) {
+        case VRAM_WRITE:    this->writeVram(address, value); break;
+        case CRAM_WRITE:    this->writeCram(address, value); break;
+        case VSRAM_WRITE:   this->writeVsram(address, value); break;
+        default: break;
         }
+    }
 
-        // According to https://plutiedev.com/mirror/kabuto-hardware-notes#hv-counter
-        if (((d->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1)) && d->counterH == 0x164) ||
-            (!(d->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1)) && d->counterH == 0x124)) {//d->beamH == 0x115 && d->beamV <= 0xE0) {
-
-            d->horizontalInterruptCount--;
-
-            if (d->horizontalInterruptCount < 0) {
-                if (d->registerData[ModeRegister1] & MODE1_IE1) {
-                    for(int i = d->counterH; i < 512; i++)
-                        d->scanLine[i] = 0xFF000088;
-
-                    this->interruptRequest(4);
-                    //d->currentCycles = 0;
-                }
-            }
-
-            d->hBlank = true;
-            //interruptFired = true;
-        }
+    // ======== Frame skipping ========
+    // Skipped frames only note their lines, the sprite flags are worked out once the status is read.
 
-        if (((d->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1)) && d->counterH == 0x0A) ||
-            (!(d->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1)) && d->counterH == 0x08)) {
+    inline void skipLine(int y) {
+        if (this->spriteLineFirst < 0)
+            this->spriteLineFirst = y;
 
-            d->horizontalInterruptCount = d->registerData[HorizontalInterruptCounter];
+        this->spriteLineLast = y;
+    }
 
-            d->hBlank = false;
-            //d->beamH = 0;
-            d->displayX = 0;
-            d->beamV++;
+    int takeSpriteStatus() {
+        if (this->spriteLineFirst >= 0) {
+            for (int y = this->spriteLineFirst; y <= this->spriteLineLast; y++)
+                this->lineRenderer->evaluateSprites(y);
 
-            //d->updateColorCache();
+            this->spriteLineFirst = -1;
         }
 
-        if (((d->registerData[ModeRegister2] & MODE2_M2) && d->counterV == 0xF0 && d->counterH == 0x00) ||
-            (!(d->registerData[ModeRegister2] & MODE2_M2) && d->counterV == 0xE0 && d->counterH == 0x00)) {
-
-            d->vertialInterruptPending = true;
-
-            if (d->registerData[ModeRegister2] & MODE2_IE0) {
-                for(int i = d->counterH; i < 512; i++)
-                    d->scanLine[i] = 0xFF880000;
-
-                //qDebug() << "VBLANK";
-
-                this->interruptRequest(6);
-                //d->currentCycles = 0;
-            }
+        int status = this->lineRenderer->takeSpriteStatus();
 
-            d->z80->interrupt();
-        }
+        if (this->renderThread)
+            status |= this->renderThread->renderer()->takeSpriteStatus();
 
-        if (((d->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1)) && d->counterH == 0x148) ||
-            (!(d->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1)) && d->counterH == 0x108)) {
+        return status;
+    }
 
-            if (((d->registerData[ModeRegister2] & MODE2_M2) && d->counterV == 0xEF) ||
-                (!(d->registerData[ModeRegister2] & MODE2_M2) && d->counterV == 0xDF)) {
+private:
+    VDP* q_ptr;
+    Q_DECLARE_PUBLIC(VDP)
+};
 
-                for(int i = d->counterH; i < 512; i++)
-                    d->scanLine[i] = 0xFF00FF00;
+VDP::VDP(QObject *parent)
+    : QObject(parent),
+      Device(),
+      d_ptr(new VDPPrivate(this))
+{
+    this->reset();
+}
 
-                //d->z80->interrupt();
-                d->vBlank = true;
-                //interruptFired = true;
-            }
+VDP::~VDP()
+{
+    Q_D(VDP);
 
-            if (d->counterV == 0x1FE) {
-                d->vBlank = false;
-                d->beamV = 0;
-                d->frameStart = true;
-            }
+    delete d->renderThread;
+    delete d->lineRenderer;
 
-            if ((d->registerData[ModeRegister2] & MODE2_M2) && d->counterV == 0x10A)
-                d->counterV = 0x1D2;
-            else if (!(d->registerData[ModeRegister2] & MODE2_M2) && d->counterV == 0x102)
-                d->counterV = 0x1CA;
-            else if (d->counterV == 0x1FF)
-                d->counterV = 0;
-            else
-                d->counterV++;
-        }
-
-        /*if (d->beamH > d->overscanWidth) {
-            d->beamH = 0;
-            d->beamV++;
+    delete d_ptr;
+}
 
-            d->updateColorCache();
-            //d->hBlank = false;
-        }*/
+void VDP::attachBus(MemoryBus* bus)
+{
+    Q_D(VDP);
 
-        /*if (d->beamH < d->screenWidth &&
-            d->beamV < d->screenScanlines &&
-            (d->registerData[ModeRegister2] & MODE2_DE) &&
-            (((d->registerData[ModeRegister1] & MODE1_L) && (d->beamH < 30)) || !(d->registerData[ModeRegister1] & MODE1_L)))
-            d->displayActive = true;
-        else
-            d->displayActive = false;*/
-
-        if (d->dmaActive && !d->dmaDataWait) {
-            //while(true) {
-            for(int i=0; i < (d->displayActive ? 4 : 88); i++) {
-
-                quint8* target = nullptr;
-                quint16 mask = 0;
-
-                switch(d->command) {
-                case VSRAM_WRITE:
-                    target = reinterpret_cast<quint8*>(d->vsram);
-                    mask = 0x3F;
-                    break;
-
-                case CRAM_WRITE:
-                    target = reinterpret_cast<quint8*>(d->cram);
-                    mask = 0x7F;
-                    break;
-
-                case VRAM_WRITE:
-                    target = reinterpret_cast<quint8*>(d->vram);
-                    mask = 0xFFFF;
-                    break;
-
-                default:
-                    qDebug() << "Invalid DMA Command" << d->command;
-                    break;
-                }
+    d->bus = bus;
+}
 
-                // Only perform DMA if we have valid information
-                if (target) {
-                    if (    (d->command != VSRAM_WRITE && d->command != CRAM_WRITE) ||
-                            (d->command == VSRAM_WRITE && d->addressRegister <= 0x3F) ||
-                            (d->command == CRAM_WRITE && d->addressRegister <= 0x7F)) {
-
-                        d->addressRegister &= mask;
-
-                        if (d->dmaType == 0) { // DMA WRITE
-                            quint8 b0, b1;
-
-                            if (d->dmaSource > 0x00FFFFFF) {
-                                d->dmaSource &= 0x0000FFFF;
-                                d->dmaSource |= 0xE00000;
-                            }
-
-                            d->bus->peek(d->dmaSource,      b0);
-                            d->bus->peek(d->dmaSource + 1,  b1);
-
-                            if (d->command == VRAM_WRITE && (d->addressRegister & 0x1)) {
-                                target[(d->addressRegister & 0xFFFE)]       = b1;
-                                target[(d->addressRegister & 0xFFFE) + 1]   = b0;
-                            } else {
-                                target[d->addressRegister & 0xFFFE ]        = b0;
-                                target[(d->addressRegister & 0xFFFE) + 1]   = b1;
-                            }
-
-                            d->dmaSource += 2;
-                        } else if (d->dmaType == 0x2) { // DMA FILL
-                            if (!d->dmaStarted && d->command == VRAM_WRITE)
-                                target[d->addressRegister] = d->dmaFillWord & 0xFF;
-                            else if (d->command != VRAM_WRITE)
-                                target[d->addressRegister] = d->dmaFillWord & 0xFF;
-
-                            target[d->addressRegister + 1] = (d->dmaFillWord >> 8) & 0xFF;
-                        } else if (d->dmaType == 0x3) { // DMA COPY
-                            d->dmaSource &= mask;
-
-                            target[d->addressRegister]       = target[d->dmaSource];
-                            target[d->addressRegister + 1]   = target[d->dmaSource + 1];
-
-                            d->dmaSource += 2;
-                        }
-
-                        if (d->command == CRAM_WRITE) {
-                            d->updateColorCache(d->addressRegister);
-                        }
-                    } else {
-                        d->dmaLength = 1;
-                    }
+MemoryBus* VDP::bus() const
+{
+    Q_D(const VDP);
 
-                    d->addressRegister += d->registerData[AutoIncrementValue];
-                }
+    return d->bus;
+}
 
-                d->dmaStarted = true;
+int VDP::clock(int cycles)
+{
+    Q_D(VDP);
 
-                d->dmaLength--;
-                if (!d->dmaLength) {
-                    d->command = NONE;
-                    d->dmaActive = false;
-                    d->dmaStarted = false;
-                    d->dmaFinishedDbg = true;
-                    d->cpu->setDisabled(false);
+    d->clockedCycles += cycles;
+    d->currentCycles -= cycles;
 
-                    //qDebug() << "ENABLE MOTOROLA";
+    (d->*(d->clock))();
 
-                    break;
-                }
-            }
-        }
+    return 0;
+}
 
-        // According to https://plutiedev.com/mirror/kabuto-hardware-notes#hv-counter
-        if ((d->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1)) && d->counterH == 0x16C)
-            d->counterH = 0x1C8;
-        else if (!(d->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1)) && d->counterH == 0x126)
-            d->counterH = 0x1D2;
-        else if (d->counterH == 0x1FF) {
-            d->counterH = 0;
-            d->beamH = -1;
-        } else
-            d->counterH++;
-
-        d->beamH++;
-
-        /*if (d->beamV >= d->overscanHeight) {
-            d->beamV = 0;
-            d->beamH = 0;
-
-            //d->vBlank = false;
-            d->oddFrame = !d->oddFrame;
-        }*/
-
-        //}
-        //if (d->oddFrame)
-        //    d->currentCycles += 2;
-        //else
-        if ((d->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1)) && d->counterH >= 0xB2 && d->counterH < 0xD0)
-            d->currentCycles += 3;
-        else if (!(d->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1)) && d->counterH >= 0x93 && d->counterH < 0xB2)
-            d->currentCycles += 8;
-        else
-            d->currentCycles += 2;
-    }
+int VDP::nextEvent() const
+{
+    Q_D(const VDP);
 
-    return 0;
+    return (d->*(d->nextEvent))();
 }
 
 void VDP::reset()
@@ -1258,35 +1164,43 @@ void VDP::reset()
 
     Device::reset();
 
-    memset(&d->registerData, 0, 25);
+    memset(&d->registerData, 0, REGISTER_COUNT);
     memset(d->vram,     0, VRAM_SIZE);
     memset(d->cram,     0, CRAM_SIZE);
     memset(d->vsram,    0, VSRAM_SIZE);
 
+    d->lineRenderer->reset();
+    d->updateTiming();
+
+    if (d->renderThread)
+        d->renderThread->write(VDPRenderThread::LOG_RESET, 0, 0);
+
     d->fifoEmpty = true;
     d->fifoFull = false;
     d->vertialInterruptPending = false;
-    d->spriteOverflow = false;
-    d->spriteCollision = true;
     d->oddFrame = false;
     d->vBlank = false;
     d->hBlank = false;
     d->dmaActive = false;
     d->writePending = false;
 
-    d->beamH = 0;
     d->beamV = 0;
     d->counterH = 0;
     d->counterV = 0;
-    d->displayX = 0;
-    d->displayY = 0;
+    d->currentCycles = 0;
+    d->clockedCycles = 0;
     d->commandCount = 0;
 
     d->command = NONE;
     d->commandByte = 0;
     d->commandData = 0;
+}
 
-    d->updateColorCache();
+void VDP::attachScheduler(Scheduler* scheduler)
+{
+    Q_D(VDP);
+
+    d->scheduler = scheduler;
 }
 
 void VDP::attachZ80(Z80* cpu)
@@ -1316,7 +1230,7 @@ void VDP::debugCRamBlit(QImage *buffer)
 
     for (int r=0; r < 4; r++) {
         for (int c=0; c < 16; c++) {
-            buffer->setPixel(c, r, d->colorCache[r][c]);
+            buffer->setPixel(c, r, d->lineRenderer->palette[(r << 4) | c] & (c == 0 ? 0x00FFFFFF : 0xFFFFFFFF));
         }
     }
 }
@@ -1325,35 +1239,98 @@ void VDP::debugBlit(QImage* buffer, quint16 address, int palette, int x, int y)
 {
     Q_D(const VDP);
 
-    d->blitPattern(buffer, address, palette, false, false, false, x, y, true);
+    d->lineRenderer->blitPattern(buffer, address, palette, false, false, x, y);
+}
+
+VideoSink* VDP::videoSink() const
+{
+    Q_D(const VDP);
+
+    return d->sink == &d->nullSink ? nullptr : d->sink;
+}
+
+void VDP::setVideoSink(VideoSink* sink)
+{
+    Q_D(VDP);
+
+    if (d->renderThread)
+        d->renderThread->fence();
+
+    // The frame in progress goes to the old sink
+    d->unlockFrame();
+
+    d->sink = sink ? sink : &d->nullSink;
+    d->lockFrame();
+}
+
+bool VDP::renderEnabled() const
+{
+    Q_D(const VDP);
+
+    return d->renderEnabled;
+}
+
+void VDP::setRenderEnabled(bool enabled)
+{
+    Q_D(VDP);
+
+    d->renderEnabled = enabled;
+}
+
+bool VDP::renderThread() const
+{
+    Q_D(const VDP);
+
+    return d->renderThread;
+}
+
+void VDP::setRenderThread(bool enabled)
+{
+    Q_D(VDP);
+
+    if (enabled == (d->renderThread != nullptr))
+        return;
+
+    if (enabled) {
+        d->renderThread = new VDPRenderThread(new VDPRenderer(d->lineRenderer));
+    } else {
+        d->renderThread->fence();
+
+        delete d->renderThread;
+        d->renderThread = nullptr;
+    }
 }
 
 void VDP::setPlaneA(bool enabled)
 {
     Q_D(VDP);
 
-    d->planeAEnabled = enabled;
+    d->lineRenderer->planeAEnabled = enabled;
+    d->updateLayers();
 }
 
 void VDP::setPlaneB(bool enabled)
 {
     Q_D(VDP);
 
-    d->planeBEnabled = enabled;
+    d->lineRenderer->planeBEnabled = enabled;
+    d->updateLayers();
 }
 
 void VDP::setWindowPlane(bool enabled)
 {
     Q_D(VDP);
 
-    d->windowPlaneEnabled = enabled;
+    d->lineRenderer->windowPlaneEnabled = enabled;
+    d->updateLayers();
 }
 
 void VDP::setSprites(bool enabled)
 {
     Q_D(VDP);
 
-    d->spritesEnabled = enabled;
+    d->lineRenderer->spritesEnabled = enabled;
+    d->updateLayers();
 }
 
 int VDP::peek(quint32 address, quint8& val)
@@ -1365,39 +1342,25 @@ int VDP::peek(quint32 address, quint8& val)
     switch(address) {
     case 0x00:       
     case 0x01:
+    {
         d->commandCount = 0;
         d->writePending = false;
 
-        quint8* target;
         int mask;
+        const quint8* target = d->dataPortTarget(&mask);
 
-        switch(d->command) {
-        case VSRAM_WRITE:
-            target = d->vsram;
-            mask = 0x7F;
-            break;
-
-        case CRAM_WRITE:
-            target = d->cram;
-            mask = 0x7F;
-            break;
-
-        case VRAM_WRITE:
-            target = d->vram;
-            mask = 0xFFFF;
-            break;
-
-        default:
+        if (!target) {
             val = 0;
             return NO_ERROR;
         }
 
-        val = target[(d->addressRegister & mask) + val];
+        val = target[(d->addressRegister + (address & 0x1)) & mask];
 
         if (address == 0x1)
             d->addressRegister += d->registerData[AutoIncrementValue];
 
         return NO_ERROR;
+    }
 
     case 0x02:
         d->commandCount = 0;
@@ -1420,31 +1383,47 @@ int VDP::peek(quint32 address, quint8& val)
         d->handleCommand(true);
         d->prepareMemoryTransfer();
 
+        int h, v;
+        bool hBlank, vBlank;
+        d->currentCounters(&h, &v, &hBlank, &vBlank);
+
+        // Sprite flags are cleared by reading them
         val = (d->vertialInterruptPending ? 0x80 : 0x00) |
-                (d->spriteOverflow ? 0x40 : 0x00) |
-                (d->spriteCollision ? 0x20 : 0x00) |
+                d->takeSpriteStatus() |
                 (d->oddFrame ? 0x10 : 0x00) |
-                (d->vBlank ? 0x08 : 0x00) |
-                (d->hBlank ? 0x04 : 0x00) |
+                (vBlank ? 0x08 : 0x00) |
+                (hBlank ? 0x04 : 0x00) |
                 (d->dmaActive ? 0x02 : 0x00) |
                 (d->screenMode == PAL ? 0x01 : 0x00);
 
         return NO_ERROR;
 
     case 0x04:
-        val = d->counterV & 0xFF;
+    {
+        int h, v;
+        bool hBlank, vBlank;
+        d->currentCounters(&h, &v, &hBlank, &vBlank);
+
+        val = v & 0xFF;
         /*if(d->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1))
             val = d->beamH > 360 ? 0xA9 : ((d->beamH >> 1) & 0xFF);
         else
             val = d->beamH > 296 ? 0xA9 : ((d->beamH >> 1) & 0xFF);*/
 
         return NO_ERROR;
+    }
 
     case 0x05:
-        val = (d->counterH >> 0) & 0xFF;
+    {
+        int h, v;
+        bool hBlank, vBlank;
+        d->currentCounters(&h, &v, &hBlank, &vBlank);
+
+        val = (h >> 0) & 0xFF;
 
         return NO_ERROR;
     }
+    }
 
     return NO_ERROR;
 }
@@ -1494,14 +1473,62 @@ int VDP::poke(quint32 address, quint8 val)
         d->commandCount++;
         d->handleCommand();
         return NO_ERROR;
-
-    case 0x06:
-        qDebug() << "PSG WRITE";
-        break;
     }
     return NO_ERROR;
 }
 
+int VDP::peek16(quint32 address, quint16& val)
+{
+    Q_D(VDP);
+
+    // Data port, read the whole word at once
+    if (address == 0x00) {
+        d->commandCount = 0;
+        d->writePending = false;
+
+        int mask;
+        const quint8* target = d->dataPortTarget(&mask);
+
+        if (target) {
+            val = static_cast<quint16>((target[d->addressRegister & mask] << 8) |
+                                        target[(d->addressRegister + 1) & mask]);
+            d->addressRegister += d->registerData[AutoIncrementValue];
+        } else {
+            val = 0;
+        }
+
+        return NO_ERROR;
+    }
+
+    return IMemory::peek16(address, val);
+}
+
+int VDP::poke16(quint32 address, quint16 val)
+{
+    Q_D(VDP);
+
+    switch(address) {
+    case 0x00:
+        // The data word is stored in VRAM byte order
+        d->dataWord = static_cast<quint16>((val >> 8) | (val << 8));
+
+        if (d->dmaDataWait) {
+            d->prepareMemoryTransfer();
+            d->performDirectWrite(d->dataWord);
+        }
+        return NO_ERROR;
+
+    case 0x02:
+        d->command0 = static_cast<quint8>(val >> 8);
+        d->command1 = static_cast<quint8>(val & 0xFF);
+        d->commandCount = 2;
+        d->handleCommand();
+        return NO_ERROR;
+    }
+
+    return IMemory::poke16(address, val);
+}
+
 void VDP::attachCpu(Motorola68000* cpu)
 {
     Q_D(VDP);
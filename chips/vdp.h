@@ -6,10 +6,10 @@
 #include <device.h>
 #include <QPixmap>
 
-#include <SDL2/SDL.h>
-
 class Motorola68000;
 class Z80;
+class Scheduler;
+class VideoSink;
 
 class VDPPrivate;
 class VDP
@@ -20,21 +20,25 @@ class VDP
       Q_OBJECT
 
    public:
-      explicit VDP(SDL_Renderer* renderer, QObject *parent = nullptr);
+      explicit VDP(QObject *parent = nullptr);
       ~VDP();
 
       void           attachBus(MemoryBus* bus);
       MemoryBus*     bus() const;
 
       int            clock(int cycles);
+      int            nextEvent() const;
 
       virtual void   reset() override;
 
       int            peek(quint32 address, quint8& val);
       int            poke(quint32 address, quint8 val);
+      int            peek16(quint32 address, quint16& val);
+      int            poke16(quint32 address, quint16 val);
 
       void           attachCpu(Motorola68000* cpu);
       void           attachZ80(Z80* cpu);
+      void           attachScheduler(Scheduler* scheduler);
 
       const QByteArray  cram() const;
       const QByteArray  vram() const;
@@ -42,8 +46,20 @@ class VDP
       void           debugCRamBlit(QImage* buffer);
       void           debugBlit(QImage* buffer, quint16 address, int palette, int x, int y) const;
 
+      // Not owned, null drops the frames
+      VideoSink*     videoSink() const;
+      void           setVideoSink(VideoSink* sink);
+
+      // Takes effect at the next frame, disabled frames keep the timing but draw nothing
+      bool           renderEnabled() const;
+      void           setRenderEnabled(bool enabled);
+
+      bool           renderThread() const;
+      void           setRenderThread(bool enabled);
+
    signals:
       void           frameUpdated(void* frame);
+      void           frameStarted();
       void           dmaFinished();
 
    public slots:
@@ -0,0 +1,75 @@
+#ifndef VDPCOLOR_H
+#define VDPCOLOR_H
+
+#include <QtGlobal>
+
+/*
+ * Host colors for every 9 bit VDP color, built at compile time.
+ *
+ * CRAM holds colors as ----BBB-GGG-RRR-, which vdpColorIndex() packs into BBBGGGRRR.
+ * There is a table for each luminance mode (MODE1_PALSEL) and each shade, shadow halves
+ * the intensity and highlight moves it into the upper half.
+ */
+
+enum VDPShade {
+    SHADE_NORMAL,
+    SHADE_SHADOW,
+    SHADE_HIGHLIGHT,
+    SHADE_COUNT
+};
+
+struct VDPColorTable {
+    quint32 argb[512];
+    quint16 rgb565[512];
+};
+
+constexpr quint8 MasterSystemLuminance[]    = { 0x00, 0x55, 0xAA, 0xFF };
+constexpr quint8 GenesisLuminance[]         = { 0x00, 0x34, 0x57, 0x74, 0x90, 0xAC, 0xCE, 0xFF };
+
+constexpr int vdpColorIndex(quint8 b0, quint8 b1) {
+    return ((b0 & 0x0E) << 5) | ((b1 & 0xE0) >> 2) | ((b1 & 0x0E) >> 1);
+}
+
+// Without MODE1_PALSEL only the lowest bit of each component is used
+constexpr quint32 vdpLuminance(bool genesis, int shade, int level) {
+    quint32 value = genesis ? GenesisLuminance[level] : MasterSystemLuminance[level & 0x1];
+
+    if (shade == SHADE_SHADOW)
+        return value >> 1;
+
+    if (shade == SHADE_HIGHLIGHT)
+        return 0x80 + (value >> 1);
+
+    return value;
+}
+
+constexpr VDPColorTable vdpBuildColorTable(bool genesis, int shade) {
+    VDPColorTable table {};
+
+    for (int i = 0; i < 512; i++) {
+        quint32 r = vdpLuminance(genesis, shade, i & 0x7);
+        quint32 g = vdpLuminance(genesis, shade, (i >> 3) & 0x7);
+        quint32 b = vdpLuminance(genesis, shade, (i >> 6) & 0x7);
+
+        table.argb[i]   = 0xFF000000 | (r << 16) | (g << 8) | b;
+        table.rgb565[i] = static_cast<quint16>(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+    }
+
+    return table;
+}
+
+// Indexed by [MODE1_PALSEL][shade]
+constexpr VDPColorTable VDPColors[2][SHADE_COUNT] = {
+    {
+        vdpBuildColorTable(false,   SHADE_NORMAL),
+        vdpBuildColorTable(false,   SHADE_SHADOW),
+        vdpBuildColorTable(false,   SHADE_HIGHLIGHT),
+    },
+    {
+        vdpBuildColorTable(true,    SHADE_NORMAL),
+        vdpBuildColorTable(true,    SHADE_SHADOW),
+        vdpBuildColorTable(true,    SHADE_HIGHLIGHT),
+    },
+};
+
+#endif // VDPCOLOR_H
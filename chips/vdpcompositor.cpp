@@ -0,0 +1,169 @@
+#include "vdpcompositor.h"
+
+#include <SDL2/SDL.h>
+
+#ifdef VDP_COMPOSITOR_X86
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+#endif
+
+static inline quint8 composePixel(quint8 planeA, quint8 planeB, quint8 sprite, quint8 background)
+{
+    quint8 mix = background;
+
+    if ((planeB & 0x0F) && !(planeB & 0x80))
+        mix = planeB;
+
+    if ((planeA & 0x0F) && !(planeA & 0x80))
+        mix = planeA;
+
+    if ((sprite & 0x0F) && !(sprite & 0x80))
+        mix = sprite;
+
+    if ((planeB & 0x0F) && (planeB & 0x80))
+        mix = planeB;
+
+    if ((planeA & 0x0F) && (planeA & 0x80))
+        mix = planeA;
+
+    if ((sprite & 0x0F) && (sprite & 0x80))
+        mix = sprite;
+
+    return mix;
+}
+
+void vdpComposeScalar(quint32* target, const quint8* planeA, const quint8* planeB, const quint8* sprite, quint8 background, const quint32* palette, int width)
+{
+    for (int x = 0; x < width; x++)
+        target[x] = palette[composePixel(planeA[x], planeB[x], sprite[x], background) & 0x3F];
+}
+
+#ifdef VDP_COMPOSITOR_X86
+
+/*
+ * Layers are applied from lowest to highest priority, a layer replaces the mix
+ * where it is opaque and its priority bit matches the current pass.
+ */
+TARGET_SSE2 static inline __m128i composeSSE2(__m128i planeA, __m128i planeB, __m128i sprite, __m128i background)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_cmpeq_epi8(zero, zero);
+    const __m128i colorMask = _mm_set1_epi8(0x0F);
+
+    __m128i transparentA = _mm_cmpeq_epi8(_mm_and_si128(planeA, colorMask), zero);
+    __m128i transparentB = _mm_cmpeq_epi8(_mm_and_si128(planeB, colorMask), zero);
+    __m128i transparentS = _mm_cmpeq_epi8(_mm_and_si128(sprite, colorMask), zero);
+
+    // Bit 7 is the sign bit of every byte
+    __m128i priorityA = _mm_cmplt_epi8(planeA, zero);
+    __m128i priorityB = _mm_cmplt_epi8(planeB, zero);
+    __m128i priorityS = _mm_cmplt_epi8(sprite, zero);
+
+    __m128i lowA = _mm_andnot_si128(_mm_or_si128(transparentA, priorityA), ones);
+    __m128i lowB = _mm_andnot_si128(_mm_or_si128(transparentB, priorityB), ones);
+    __m128i lowS = _mm_andnot_si128(_mm_or_si128(transparentS, priorityS), ones);
+    __m128i highA = _mm_andnot_si128(transparentA, priorityA);
+    __m128i highB = _mm_andnot_si128(transparentB, priorityB);
+    __m128i highS = _mm_andnot_si128(transparentS, priorityS);
+
+    __m128i mix = background;
+    mix = _mm_or_si128(_mm_and_si128(lowB, planeB), _mm_andnot_si128(lowB, mix));
+    mix = _mm_or_si128(_mm_and_si128(lowA, planeA), _mm_andnot_si128(lowA, mix));
+    mix = _mm_or_si128(_mm_and_si128(lowS, sprite), _mm_andnot_si128(lowS, mix));
+    mix = _mm_or_si128(_mm_and_si128(highB, planeB), _mm_andnot_si128(highB, mix));
+    mix = _mm_or_si128(_mm_and_si128(highA, planeA), _mm_andnot_si128(highA, mix));
+    mix = _mm_or_si128(_mm_and_si128(highS, sprite), _mm_andnot_si128(highS, mix));
+
+    return _mm_and_si128(mix, _mm_set1_epi8(0x3F));
+}
+
+TARGET_SSE2 void vdpComposeSSE2(quint32* target, const quint8* planeA, const quint8* planeB, const quint8* sprite, quint8 background, const quint32* palette, int width)
+{
+    const __m128i bg = _mm_set1_epi8(static_cast<char>(background));
+    alignas(16) quint8 indices[16];
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i mix = composeSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(planeA + x)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(planeB + x)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(sprite + x)),
+                                  bg);
+
+        // SSE2 has no gather, the palette lookup stays scalar
+        _mm_store_si128(reinterpret_cast<__m128i*>(indices), mix);
+
+        for (int i = 0; i < 16; i++)
+            target[x + i] = palette[indices[i]];
+    }
+
+    vdpComposeScalar(target + x, planeA + x, planeB + x, sprite + x, background, palette, width - x);
+}
+
+TARGET_AVX2 static inline __m256i composeAVX2(__m256i planeA, __m256i planeB, __m256i sprite, __m256i background)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i colorMask = _mm256_set1_epi8(0x0F);
+
+    __m256i transparentA = _mm256_cmpeq_epi8(_mm256_and_si256(planeA, colorMask), zero);
+    __m256i transparentB = _mm256_cmpeq_epi8(_mm256_and_si256(planeB, colorMask), zero);
+    __m256i transparentS = _mm256_cmpeq_epi8(_mm256_and_si256(sprite, colorMask), zero);
+
+    // Bit 7 is the sign bit of every byte, blendv selects on it directly
+    __m256i mix = background;
+    mix = _mm256_blendv_epi8(planeB, mix, _mm256_or_si256(transparentB, planeB));
+    mix = _mm256_blendv_epi8(planeA, mix, _mm256_or_si256(transparentA, planeA));
+    mix = _mm256_blendv_epi8(sprite, mix, _mm256_or_si256(transparentS, sprite));
+    mix = _mm256_blendv_epi8(mix, planeB, _mm256_andnot_si256(transparentB, planeB));
+    mix = _mm256_blendv_epi8(mix, planeA, _mm256_andnot_si256(transparentA, planeA));
+    mix = _mm256_blendv_epi8(mix, sprite, _mm256_andnot_si256(transparentS, sprite));
+
+    return _mm256_and_si256(mix, _mm256_set1_epi8(0x3F));
+}
+
+TARGET_AVX2 void vdpComposeAVX2(quint32* target, const quint8* planeA, const quint8* planeB, const quint8* sprite, quint8 background, const quint32* palette, int width)
+{
+    const __m256i bg = _mm256_set1_epi8(static_cast<char>(background));
+    const int* colors = reinterpret_cast<const int*>(palette);
+
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i mix = composeAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(planeA + x)),
+                                  _mm256_loadu_si256(reinterpret_cast<const __m256i*>(planeB + x)),
+                                  _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sprite + x)),
+                                  bg);
+
+        __m128i low = _mm256_castsi256_si128(mix);
+        __m128i high = _mm256_extracti128_si256(mix, 1);
+
+        // Widen the indices to 32 bits and gather eight colors at a time
+        __m256i* out = reinterpret_cast<__m256i*>(target + x);
+        _mm256_storeu_si256(out,     _mm256_i32gather_epi32(colors, _mm256_cvtepu8_epi32(low), 4));
+        _mm256_storeu_si256(out + 1, _mm256_i32gather_epi32(colors, _mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)), 4));
+        _mm256_storeu_si256(out + 2, _mm256_i32gather_epi32(colors, _mm256_cvtepu8_epi32(high), 4));
+        _mm256_storeu_si256(out + 3, _mm256_i32gather_epi32(colors, _mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)), 4));
+    }
+
+    vdpComposeScalar(target + x, planeA + x, planeB + x, sprite + x, background, palette, width - x);
+}
+
+#endif
+
+VDPCompositor vdpSelectCompositor()
+{
+#ifdef VDP_COMPOSITOR_X86
+    if (SDL_HasAVX2())
+        return vdpComposeAVX2;
+
+    if (SDL_HasSSE2())
+        return vdpComposeSSE2;
+#endif
+
+    return vdpComposeScalar;
+}
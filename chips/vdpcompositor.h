@@ -0,0 +1,34 @@
+#ifndef VDPCOMPOSITOR_H
+#define VDPCOMPOSITOR_H
+
+#include <QtGlobal>
+
+/*
+ * Line compositors resolve the layer priorities of one scanline and look up the final colors.
+ *
+ * Every layer holds one byte per pixel: bits 0-5 are the CRAM index, bit 7 is the priority.
+ * A pixel is transparent when its color index within the palette is zero. The palette holds
+ * the 64 CRAM colors as ARGB.
+ */
+typedef void (*VDPCompositor)(quint32* target,
+                              const quint8* planeA,
+                              const quint8* planeB,
+                              const quint8* sprite,
+                              quint8 background,
+                              const quint32* palette,
+                              int width);
+
+// Reference implementation
+void vdpComposeScalar(quint32* target, const quint8* planeA, const quint8* planeB, const quint8* sprite, quint8 background, const quint32* palette, int width);
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define VDP_COMPOSITOR_X86
+
+void vdpComposeSSE2(quint32* target, const quint8* planeA, const quint8* planeB, const quint8* sprite, quint8 background, const quint32* palette, int width);
+void vdpComposeAVX2(quint32* target, const quint8* planeA, const quint8* planeB, const quint8* sprite, quint8 background, const quint32* palette, int width);
+#endif
+
+// Picks the fastest compositor the host CPU supports
+VDPCompositor vdpSelectCompositor();
+
+#endif // VDPCOMPOSITOR_H
@@ -0,0 +1,78 @@
+#ifndef VDPREGISTERS_H
+#define VDPREGISTERS_H
+
+#define VRAM_SIZE 0x10000
+#define CRAM_SIZE 0x80
+#define VSRAM_SIZE 0x50
+#define REGISTER_COUNT 25
+
+enum Register {
+    ModeRegister1     = 0x00,
+    ModeRegister2     = 0x01,
+    PlaneANameTable   = 0x02,
+    WindowNameTable   = 0x03,
+    PlaneBNameTable   = 0x04,
+    SpriteTable       = 0x05,
+    SpritePatternGenerator = 0x06,
+    BackgroundColor   = 0x07,
+    HorizontalInterruptCounter = 0x0A,
+    ModeRegister3     = 0x0B,
+    ModeRegister4     = 0x0C,
+    HScrollData       = 0x0D,
+    NameTablePatternGenerator = 0x0E,
+    AutoIncrementValue = 0x0F,
+    PlaneSize         = 0x10,
+    WindowPlaneHPos   = 0x11,
+    WindowPlaneVPos   = 0x12,
+    DMALength0        = 0x13,
+    DMALength1        = 0x14,
+    DMASource0        = 0x15,
+    DMASource1        = 0x16,
+    DMASource2        = 0x17,
+};
+
+enum ModeRegister1 {
+    MODE1_L     = 0x20,
+    MODE1_IE1   = 0x10,
+    MODE1_INVAL = 0x08,
+    MODE1_PALSEL= 0x04,
+    MODE1_M3    = 0x02,
+    MODE1_DD    = 0x01,
+};
+
+enum ModeRegister2 {
+    MODE2_VRAM  = 0x80,
+    MODE2_DE    = 0x40,
+    MODE2_IE0   = 0x20,
+    MODE2_M1    = 0x10,
+    MODE2_M2    = 0x08,
+    MODE2_M5    = 0x04,
+};
+
+enum ModeRegister3 {
+    MODE3_IE2   = 0x8,
+    MODE3_VS    = 0x4,
+    MODE3_HS    = 0x3,
+    MODE3_HS1   = 0x2,
+    MODE3_HS2   = 0x1,
+};
+
+enum ModeRegister4 {
+    MODE4_RS0   = 0x80,
+    MODE4_VSY   = 0x40,
+    MODE4_HSY   = 0x20,
+    MODE4_SPR   = 0x10,
+    MODE4_SHI   = 0x08,
+    MODE4_LSM   = 0x06,
+    MODE4_LSM1  = 0x04,
+    MODE4_LSM0  = 0x02,
+    MODE4_RS1   = 0x01,
+};
+
+enum Plane {
+    PLANEA,
+    PLANEB,
+    WINDOWPLANE,
+};
+
+#endif // VDPREGISTERS_H
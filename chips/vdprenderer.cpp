@@ -0,0 +1,547 @@
+#include "vdprenderer.h"
+#include "vdpcolor.h"
+
+#include <QImage>
+#include <QtEndian>
+#include <algorithm>
+
+// Status register bits
+#define STATUS_SPRITE_OVERFLOW  0x40
+#define STATUS_SPRITE_COLLISION 0x20
+
+VDPRenderer::VDPRenderer(quint8* vram, quint8* cram, quint8* vsram, quint8* registerData)
+    : vram(vram),
+      cram(cram),
+      vsram(vsram),
+      registerData(registerData),
+      ownsMemory(false),
+      frameBuffer(nullptr),
+      frameBufferPitch(FRAMEBUFFER_WIDTH),
+      screenScanlines(224),
+      screenWidth(256),
+      planeWidth(32),
+      planeHeight(32),
+      planeAEnabled(true),
+      planeBEnabled(true),
+      windowPlaneEnabled(true),
+      spritesEnabled(true),
+      spriteTableDirty(true),
+      spriteDotOverflow(false),
+      spriteStatus(0)
+{
+    this->compositor = vdpSelectCompositor();
+
+    this->invalidateVram();
+    this->updateColorCache();
+}
+
+VDPRenderer::VDPRenderer(const VDPRenderer* source)
+    : VDPRenderer(static_cast<quint8*>(malloc(VRAM_SIZE)),
+                  static_cast<quint8*>(malloc(CRAM_SIZE)),
+                  static_cast<quint8*>(malloc(VSRAM_SIZE)),
+                  static_cast<quint8*>(malloc(REGISTER_COUNT)))
+{
+    this->ownsMemory = true;
+
+    memcpy(this->vram,          source->vram,           VRAM_SIZE);
+    memcpy(this->cram,          source->cram,           CRAM_SIZE);
+    memcpy(this->vsram,         source->vsram,          VSRAM_SIZE);
+    memcpy(this->registerData,  source->registerData,   REGISTER_COUNT);
+
+    this->frameBuffer = source->frameBuffer;
+    this->frameBufferPitch = source->frameBufferPitch;
+
+    this->screenScanlines = source->screenScanlines;
+    this->screenWidth = source->screenWidth;
+    this->planeWidth = source->planeWidth;
+    this->planeHeight = source->planeHeight;
+
+    this->planeAEnabled = source->planeAEnabled;
+    this->planeBEnabled = source->planeBEnabled;
+    this->windowPlaneEnabled = source->windowPlaneEnabled;
+    this->spritesEnabled = source->spritesEnabled;
+    this->spriteDotOverflow = source->spriteDotOverflow;
+
+    this->updateColorCache();
+}
+
+VDPRenderer::~VDPRenderer()
+{
+    if (this->ownsMemory) {
+        free(this->vram);
+        free(this->cram);
+        free(this->vsram);
+        free(this->registerData);
+    }
+}
+
+void VDPRenderer::writeVram(quint16 address, quint8 value)
+{
+    this->vram[address] = value;
+    this->invalidateVram(address);
+}
+
+// Block writes must not wrap around the end of the VRAM
+void VDPRenderer::writeVram(quint16 address, const quint8* data, int length)
+{
+    memcpy(this->vram + address, data, length);
+    this->invalidateVram(address, length);
+}
+
+void VDPRenderer::fillVram(quint16 address, quint8 value, int length)
+{
+    memset(this->vram + address, value, length);
+    this->invalidateVram(address, length);
+}
+
+// Both ranges must stay within the VRAM
+void VDPRenderer::copyVram(quint16 address, quint16 source, int length)
+{
+    memmove(this->vram + address, this->vram + source, length);
+    this->invalidateVram(address, length);
+}
+
+void VDPRenderer::writeCram(quint8 address, quint8 value)
+{
+    this->cram[address] = value;
+    this->updateColorCache(address);
+}
+
+void VDPRenderer::writeVsram(quint8 address, quint8 value)
+{
+    this->vsram[address] = value;
+}
+
+void VDPRenderer::writeRegister(quint8 reg, quint8 value)
+{
+    this->registerData[reg] = value;
+
+    if (reg == SpriteTable || reg == ModeRegister4)
+        this->spriteTableDirty = true;
+
+    if (reg == ModeRegister1)
+        this->updateColorCache();
+}
+
+void VDPRenderer::reset()
+{
+    if (this->ownsMemory) {
+        memset(this->vram,          0, VRAM_SIZE);
+        memset(this->cram,          0, CRAM_SIZE);
+        memset(this->vsram,         0, VSRAM_SIZE);
+        memset(this->registerData,  0, REGISTER_COUNT);
+    }
+
+    this->spriteDotOverflow = false;
+    this->spriteStatus.store(0);
+
+    this->invalidateVram();
+    this->updateColorCache();
+}
+
+void VDPRenderer::frameStart()
+{
+    // Screen resolution
+    this->screenScanlines  = (this->registerData[ModeRegister2] & MODE2_M2) ? 240 : 224;
+    this->screenWidth      = ((this->registerData[ModeRegister4] & MODE4_RS0) && (this->registerData[ModeRegister4] & MODE4_RS1)) ? 320 : 256;
+
+    // Background size
+    switch ((this->registerData[PlaneSize] & 0x30) >> 4) {
+    case 0x02:
+    case 0x00: this->planeHeight = 32; break;
+    case 0x01: this->planeHeight = 64; break;
+    case 0x03: this->planeHeight = 128; break;
+    }
+
+    switch ((this->registerData[PlaneSize] & 0x03)) {
+    case 0x02:
+    case 0x00: this->planeWidth = 32; break;
+    case 0x01: this->planeWidth = 64; break;
+    case 0x03: this->planeWidth = 128; break;
+    }
+}
+
+void VDPRenderer::evaluateSprites(int y)
+{
+    if (!(this->registerData[ModeRegister2] & MODE2_DE) || y >= this->screenScanlines || !this->spritesEnabled)
+        return;
+
+    this->renderSpriteLine(this->spriteLine, y);
+}
+
+void VDPRenderer::setFrameBuffer(quint32* frameBuffer, int pitch)
+{
+    this->frameBuffer = frameBuffer;
+    this->frameBufferPitch = pitch;
+}
+
+void VDPRenderer::renderLine(int row, int y, bool vBlank)
+{
+    quint32* scanLine = this->frameBuffer + row * this->frameBufferPitch;
+
+    // Beam positions of the active display, see the counter timing of the VDP
+    int lineLength = this->h40() ? (0x16D + 0x200 - 0x1C8) : (0x127 + 0x200 - 0x1D2);
+    int firstPixel = this->h40() ? 0x0B : 0x09;
+    int lastPixel = this->h40() ? 0x164 : 0x124;
+
+    // The frame buffer is a locked texture without the previous contents, every pixel is written
+    std::fill(scanLine + lineLength, scanLine + FRAMEBUFFER_WIDTH, 0);
+
+    if (vBlank) {
+        std::fill(scanLine, scanLine + lineLength, 0xFF888800);
+        return;
+    }
+
+    std::fill(scanLine, scanLine + firstPixel, 0xFF888800);
+    std::fill(scanLine + lastPixel + 1, scanLine + lineLength, 0xFF888800);
+
+    if (!(this->registerData[ModeRegister2] & MODE2_DE)) {
+        std::fill(scanLine + firstPixel, scanLine + lastPixel + 1, 0);
+        return;
+    }
+
+    int width = 0;
+
+    if (y < this->screenScanlines) {
+        width = this->screenWidth;
+
+        if (this->planeAEnabled)
+            this->renderPlaneLine(PLANEA, this->planeALine, y);
+        else
+            memset(this->planeALine, 0, width);
+
+        if (this->planeBEnabled)
+            this->renderPlaneLine(PLANEB, this->planeBLine, y);
+        else
+            memset(this->planeBLine, 0, width);
+
+        if (this->spritesEnabled)
+            this->renderSpriteLine(this->spriteLine, y);
+        else
+            memset(this->spriteLine, 0, width);
+
+        this->compositor(scanLine + firstPixel,
+                         this->planeALine,
+                         this->planeBLine,
+                         this->spriteLine,
+                         this->registerData[BackgroundColor] & 0x3F,
+                         this->palette,
+                         width);
+    }
+
+    std::fill(scanLine + firstPixel + width, scanLine + lastPixel + 1, 0xFF000000);
+}
+
+int VDPRenderer::takeSpriteStatus()
+{
+    return this->spriteStatus.fetchAndStoreOrdered(0);
+}
+
+void VDPRenderer::blitPattern(QImage* buffer, quint16 address, int palette, bool flipH, bool flipV, int dstX, int dstY) const
+{
+    const quint8* pattern = this->tile(address >> 5, flipH);
+
+    for (int y=0; y < 8; y++) {
+        const quint8* row = pattern + ((flipV ? 7 - y : y) << 3);
+        int tY = dstY + y;
+
+        if (tY < 0 || tY >= buffer->height())
+            continue;
+
+        quint32* scanline = reinterpret_cast<quint32*>(buffer->scanLine(tY));
+
+        for (int x=0; x < 8; x++) {
+            int tX = dstX + x;
+
+            if (tX < 0 || tX >= buffer->width())
+                continue;
+
+            quint8 index = row[x];
+
+            if (index)
+                scanline[tX] = this->palette[(palette << 4) | index];
+        }
+    }
+}
+
+// ======== Colors ========
+
+void VDPRenderer::updateColorCache()
+{
+    for (int address = 0; address < CRAM_SIZE; address += 2)
+        this->updateColorCache(address);
+}
+
+void VDPRenderer::updateColorCache(int address)
+{
+    const VDPColorTable& table = VDPColors[(this->registerData[ModeRegister1] & MODE1_PALSEL) ? 1 : 0][SHADE_NORMAL];
+
+    address &= ~0x1;
+
+    this->palette[address >> 1] = table.argb[vdpColorIndex(this->cram[address], this->cram[address + 1])];
+}
+
+// ======== Tile cache ========
+
+void VDPRenderer::invalidateVram(quint16 address)
+{
+    int index = address >> 5;
+
+    this->tileDirty[index >> 5] |= (1u << (index & 31));
+
+    if (static_cast<quint16>(address - this->spriteTableAddress()) < SPRITE_COUNT * 8)
+        this->spriteTableDirty = true;
+}
+
+void VDPRenderer::invalidateVram(quint16 address, int length)
+{
+    for (int index = address >> 5; index <= (address + length - 1) >> 5; index++)
+        this->tileDirty[index >> 5] |= (1u << (index & 31));
+
+    quint16 table = this->spriteTableAddress();
+
+    if (static_cast<quint16>(address - table) < SPRITE_COUNT * 8 || static_cast<quint16>(table - address) < length)
+        this->spriteTableDirty = true;
+}
+
+void VDPRenderer::invalidateVram()
+{
+    memset(this->tileDirty, 0xFF, sizeof(this->tileDirty));
+    this->spriteTableDirty = true;
+}
+
+void VDPRenderer::decodeTile(int index) const
+{
+    const quint8* pattern = this->vram + (index << 5);
+    quint8* tile = this->tileCache + (index * 128);
+    quint8* flipped = tile + 64;
+
+    for (int i = 0; i < 32; i++) {
+        int y = (i >> 2) << 3;
+        int x = (i & 3) << 1;
+
+        tile[y + x]             = pattern[i] >> 4;
+        tile[y + x + 1]         = pattern[i] & 0x0F;
+        flipped[y + 7 - x]      = pattern[i] >> 4;
+        flipped[y + 6 - x]      = pattern[i] & 0x0F;
+    }
+
+    this->tileDirty[index >> 5] &= ~(1u << (index & 31));
+}
+
+// ======== Sprites ========
+
+quint16 VDPRenderer::spriteTableAddress() const
+{
+    // AT9 is ignored in H40 mode
+    return static_cast<quint16>((this->registerData[SpriteTable] & (this->h40() ? 0x7E : 0x7F)) << 9);
+}
+
+void VDPRenderer::parseSpriteTable()
+{
+    quint16 base = this->spriteTableAddress();
+
+    for (int i = 0; i < SPRITE_COUNT; i++) {
+        const quint8* entry = this->vram + ((base + i * 8) & 0xFFFF);
+
+        this->sprites[i] = SpriteEntry{
+            static_cast<quint16>(((entry[0] << 8) | entry[1]) & 0x3FF),
+            static_cast<quint8>(((entry[2] >> 2) & 0x3) + 1),
+            static_cast<quint8>((entry[2] & 0x3) + 1),
+            static_cast<quint8>(entry[3] & 0x7F),
+            static_cast<quint16>((entry[4] << 8) | entry[5]),
+            static_cast<quint16>(((entry[6] << 8) | entry[7]) & 0x1FF)
+        };
+    }
+
+    this->spriteTableDirty = false;
+}
+
+void VDPRenderer::drawSprite(quint8* line, const SpriteEntry& sprite, int row, int width)
+{
+    bool hFlip = sprite.attributes & 0x800;
+    bool vFlip = sprite.attributes & 0x1000;
+    quint8 attributes = static_cast<quint8>(((sprite.attributes & 0x6000) >> 9) | ((sprite.attributes & 0x8000) >> 8));
+    int left = sprite.x - 128;
+    bool collision = false;
+
+    if (vFlip)
+        row = (sprite.h * 8 - 1) - row;
+
+    // Sprite patterns are laid out column by column
+    for (int column = 0; column * 8 < width; column++) {
+        int tileColumn = hFlip ? (sprite.w - 1) - column : column;
+        const quint8* pixels = this->tile((sprite.attributes & 0x7FF) + tileColumn * sprite.h + (row >> 3), hFlip) + ((row & 7) << 3);
+        int count = qMin(8, width - column * 8);
+
+        for (int i = 0; i < count; i++) {
+            int x = left + column * 8 + i;
+
+            if (x < 0 || x >= this->screenWidth || !pixels[i])
+                continue;
+
+            // The first sprite in the list wins
+            if (line[x] & 0x0F)
+                collision = true;
+            else
+                line[x] = pixels[i] | attributes;
+        }
+    }
+
+    if (collision)
+        this->spriteStatus.fetchAndOrRelaxed(STATUS_SPRITE_COLLISION);
+}
+
+void VDPRenderer::renderSpriteLine(quint8* line, int y)
+{
+    memset(line, 0, this->screenWidth);
+
+    if (this->spriteTableDirty)
+        this->parseSpriteTable();
+
+    int maxSprites = this->h40() ? 80 : 64;
+    int maxLineSprites = this->h40() ? 20 : 16;
+
+    int lineSprites = 0;
+    int linePixels = 0;
+    bool dotOverflow = false;
+    bool masked = false;
+
+    // A sprite at x = 0 only masks the ones behind it after a visible sprite or a full previous line
+    bool maskEnabled = this->spriteDotOverflow;
+
+    int index = 0;
+    for (int i = 0; i < maxSprites; i++) {
+        const SpriteEntry& sprite = this->sprites[index];
+        int row = y - ((sprite.y & 0x1FF) - 128);
+
+        if (row >= 0 && row < sprite.h * 8) {
+            if (lineSprites == maxLineSprites) {
+                this->spriteStatus.fetchAndOrRelaxed(STATUS_SPRITE_OVERFLOW);
+                break;
+            }
+
+            lineSprites++;
+
+            if (!sprite.x)
+                masked |= maskEnabled;
+            else
+                maskEnabled = true;
+
+            int width = sprite.w * 8;
+
+            if (linePixels + width >= this->screenWidth) {
+                width = this->screenWidth - linePixels;
+                dotOverflow = true;
+            }
+
+            linePixels += width;
+
+            if (!masked)
+                this->drawSprite(line, sprite, row, width);
+
+            if (dotOverflow)
+                break;
+        }
+
+        if (!sprite.link || sprite.link >= maxSprites)
+            break;
+
+        index = sprite.link;
+    }
+
+    this->spriteDotOverflow = dotOverflow;
+}
+
+// ======== Planes ========
+// Every layer is rendered into a line buffer of CRAM indices, bit 7 holds the priority.
+// A pixel is transparent when its color index within the palette is zero.
+
+void VDPRenderer::renderPlaneLine(int plane, quint8* line, int y) const
+{
+    int baseAddress = 0;
+    int patternH, factor;
+
+    if (this->registerData[ModeRegister4] & MODE4_LSM) {
+        patternH = 16;
+        factor = 2;
+    } else {
+        patternH = 8;
+        factor = 1;
+    }
+
+    switch (plane) {
+    case PLANEA:
+        baseAddress = (this->registerData[PlaneANameTable] & 0x38) << 10;
+        break;
+
+    case PLANEB:
+        baseAddress = (this->registerData[PlaneBNameTable] & 0x7) << 13;
+        break;
+
+    default:
+        return;
+    }
+
+    const quint16* nametable = reinterpret_cast<const quint16*>(this->vram + baseAddress);
+    const quint16* hScrollData = reinterpret_cast<const quint16*>(this->vram + ((this->registerData[HScrollData] & 0x3F) << 10));
+    const quint16* vScrollData = reinterpret_cast<const quint16*>(this->vsram);
+
+    // Plane sizes are powers of two, masking also wraps negative coordinates
+    int planeMaskX = this->planeWidth * 8 - 1;
+    int planeMaskY = this->planeHeight * patternH - 1;
+
+    // Horizontal scroll is fixed for the whole line
+    int scrollX = 0;
+
+    switch (this->registerData[ModeRegister3] & MODE3_HS) {
+    case 0x00:
+        scrollX = qFromBigEndian(hScrollData[plane]);
+        break;
+
+    case 0x02:
+        scrollX = qFromBigEndian(hScrollData[(y / 8) * 16 + plane]);
+        break;
+
+    case 0x03:
+        scrollX = qFromBigEndian(hScrollData[y * 2 + plane]);
+        break;
+    }
+
+    bool columnScroll = this->registerData[ModeRegister3] & MODE3_VS;
+    int scrollY = qFromBigEndian(vScrollData[plane]);
+
+    int x = 0;
+    while (x < this->screenWidth) {
+        if (columnScroll)
+            scrollY = qFromBigEndian(vScrollData[(x / 16) * 2 + plane]);
+
+        int planeX = (x - scrollX) & planeMaskX;
+        int planeY = (y + scrollY) & planeMaskY;
+
+        quint16 entry = qFromBigEndian(nametable[(planeY / patternH) * this->planeWidth + (planeX / 8)]);
+
+        int subtileY = planeY % patternH;
+
+        // Vertical Flip
+        if (entry & 0x1000)
+            subtileY = (patternH - 1) - subtileY;
+
+        // Divide by interlace factor
+        subtileY /= factor;
+
+        // Copy the part of the tile row that is on screen, the cache holds the flipped copy
+        const quint8* pixels = this->tile(entry & 0x7FF, entry & 0x800) + (subtileY << 3) + (planeX & 7);
+        quint8 attributes = static_cast<quint8>(((entry & 0x6000) >> 9) | ((entry & 0x8000) >> 8));
+
+        int count = qMin(8 - (planeX & 7), this->screenWidth - x);
+
+        if (columnScroll)
+            count = qMin(count, 16 - (x & 15));
+
+        for (int i = 0; i < count; i++)
+            line[x + i] = pixels[i] | attributes;
+
+        x += count;
+    }
+}
@@ -0,0 +1,136 @@
+#ifndef VDPRENDERER_H
+#define VDPRENDERER_H
+
+#include <QtGlobal>
+#include <QAtomicInt>
+
+#include "vdpregisters.h"
+#include "vdpcompositor.h"
+
+#define LINE_SIZE 320
+#define TILE_COUNT 2048
+#define SPRITE_COUNT 80
+
+// Large enough for the longest line (H40) and the most lines per frame (PAL)
+#define FRAMEBUFFER_WIDTH 432
+#define FRAMEBUFFER_HEIGHT 320
+
+class QImage;
+
+struct SpriteEntry {
+    quint16 y;
+    quint8  w;
+    quint8  h;
+    quint8  link;
+    quint16 attributes;
+    quint16 x;
+};
+
+/*
+ * Draws VDP scanlines into a frame buffer.
+ *
+ * The renderer either works on the memory of the VDP itself or on a private copy
+ * that is kept up to date by replaying the writes made to the VDP.
+ */
+class VDPRenderer
+{
+public:
+    quint8*     vram;
+    quint8*     cram;
+    quint8*     vsram;
+    quint8*     registerData;
+    bool        ownsMemory;
+
+    quint32*    frameBuffer;
+    int         frameBufferPitch;
+
+    int         screenScanlines;
+    int         screenWidth;
+    int         planeWidth;
+    int         planeHeight;
+
+    bool        planeAEnabled;
+    bool        planeBEnabled;
+    bool        windowPlaneEnabled;
+    bool        spritesEnabled;
+
+    // CRAM colors as ARGB, alpha is always set
+    quint32     palette[64];
+    VDPCompositor compositor;
+
+    SpriteEntry sprites[SPRITE_COUNT];
+    bool        spriteTableDirty;
+    bool        spriteDotOverflow;
+    QAtomicInt  spriteStatus;
+
+    // Decoded patterns, one byte per pixel followed by the horizontally flipped copy
+    mutable quint8  tileCache[TILE_COUNT * 2 * 64];
+    mutable quint32 tileDirty[TILE_COUNT / 32];
+
+    quint8      planeALine[LINE_SIZE];
+    quint8      planeBLine[LINE_SIZE];
+    quint8      spriteLine[LINE_SIZE];
+
+public:
+    // Renders straight from the given VDP memory
+    VDPRenderer(quint8* vram, quint8* cram, quint8* vsram, quint8* registerData);
+
+    // Renders from a private copy of the memory of another renderer
+    explicit VDPRenderer(const VDPRenderer* source);
+
+    ~VDPRenderer();
+
+    // Memory writes, addresses are already wrapped to the memory sizes
+    void writeVram(quint16 address, quint8 value);
+    void writeVram(quint16 address, const quint8* data, int length);
+    void fillVram(quint16 address, quint8 value, int length);
+    void copyVram(quint16 address, quint16 source, int length);
+    void writeCram(quint8 address, quint8 value);
+    void writeVsram(quint8 address, quint8 value);
+    void writeRegister(quint8 reg, quint8 value);
+
+    // Pitch is given in pixels
+    void setFrameBuffer(quint32* frameBuffer, int pitch);
+
+    void reset();
+    void frameStart();
+    void renderLine(int row, int y, bool vBlank);
+
+    // Only updates the sprite status of a line
+    void evaluateSprites(int y);
+
+    // Returns the sprite overflow and collision status bits and clears them
+    int  takeSpriteStatus();
+
+    void blitPattern(QImage* buffer, quint16 address, int palette, bool flipH, bool flipV, int dstX, int dstY) const;
+
+private:
+    inline bool h40() const {
+        return this->registerData[ModeRegister4] & (MODE4_RS0 | MODE4_RS1);
+    }
+
+    void        updateColorCache();
+    void        updateColorCache(int address);
+
+    void        invalidateVram(quint16 address);
+    void        invalidateVram(quint16 address, int length);
+    void        invalidateVram();
+    void        decodeTile(int index) const;
+
+    inline const quint8* tile(int index, bool flipH) const {
+        index &= (TILE_COUNT - 1);
+
+        if (this->tileDirty[index >> 5] & (1u << (index & 31)))
+            this->decodeTile(index);
+
+        return this->tileCache + (index * 128) + (flipH ? 64 : 0);
+    }
+
+    quint16     spriteTableAddress() const;
+    void        parseSpriteTable();
+    void        drawSprite(quint8* line, const SpriteEntry& sprite, int row, int width);
+    void        renderSpriteLine(quint8* line, int y);
+    void        renderPlaneLine(int plane, quint8* line, int y) const;
+};
+
+#endif // VDPRENDERER_H
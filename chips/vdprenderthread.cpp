@@ -0,0 +1,122 @@
+#include "vdprenderthread.h"
+
+enum LayerFlag {
+    LAYER_PLANE_A   = 0x01,
+    LAYER_PLANE_B   = 0x02,
+    LAYER_WINDOW    = 0x04,
+    LAYER_SPRITES   = 0x08,
+};
+
+VDPRenderThread::VDPRenderThread(VDPRenderer* renderer, QObject* parent)
+    : QThread(parent),
+      lineRenderer(renderer),
+      head(0),
+      tail(0)
+{
+    this->log = new VDPLogEntry[RENDER_LOG_SIZE];
+
+    this->start();
+}
+
+VDPRenderThread::~VDPRenderThread()
+{
+    this->push(VDPLogEntry{ LOG_STOP, 0, 0, 0 });
+    this->pending.release();
+    this->wait();
+
+    delete[] this->log;
+    delete this->lineRenderer;
+}
+
+VDPRenderer* VDPRenderThread::renderer() const
+{
+    return this->lineRenderer;
+}
+
+void VDPRenderThread::setLayers(bool planeA, bool planeB, bool window, bool sprites)
+{
+    quint8 layers = (planeA ? LAYER_PLANE_A : 0) |
+                    (planeB ? LAYER_PLANE_B : 0) |
+                    (window ? LAYER_WINDOW : 0) |
+                    (sprites ? LAYER_SPRITES : 0);
+
+    this->push(VDPLogEntry{ LOG_LAYERS, layers, 0, 0 });
+}
+
+void VDPRenderThread::frameStart()
+{
+    this->push(VDPLogEntry{ LOG_FRAME, 0, 0, 0 });
+}
+
+void VDPRenderThread::line(int row, int y, bool vBlank)
+{
+    this->push(VDPLogEntry{ LOG_LINE, vBlank, static_cast<quint16>(row), y });
+    this->pending.release();
+}
+
+void VDPRenderThread::fence()
+{
+    this->push(VDPLogEntry{ LOG_FENCE, 0, 0, 0 });
+    this->pending.release();
+    this->fenceDone.acquire();
+}
+
+void VDPRenderThread::run()
+{
+    forever {
+        this->pending.acquire();
+
+        int tail = this->tail.load();
+
+        while (tail != this->head.loadAcquire()) {
+            const VDPLogEntry entry = this->log[tail];
+
+            tail = (tail + 1) & (RENDER_LOG_SIZE - 1);
+            this->tail.storeRelease(tail);
+
+            switch (entry.type) {
+            case LOG_VRAM:
+                this->lineRenderer->writeVram(entry.address, entry.value);
+                break;
+
+            case LOG_CRAM:
+                this->lineRenderer->writeCram(static_cast<quint8>(entry.address), entry.value);
+                break;
+
+            case LOG_VSRAM:
+                this->lineRenderer->writeVsram(static_cast<quint8>(entry.address), entry.value);
+                break;
+
+            case LOG_REGISTER:
+                this->lineRenderer->writeRegister(static_cast<quint8>(entry.address), entry.value);
+                break;
+
+            case LOG_LAYERS:
+                this->lineRenderer->planeAEnabled = entry.value & LAYER_PLANE_A;
+                this->lineRenderer->planeBEnabled = entry.value & LAYER_PLANE_B;
+                this->lineRenderer->windowPlaneEnabled = entry.value & LAYER_WINDOW;
+                this->lineRenderer->spritesEnabled = entry.value & LAYER_SPRITES;
+                break;
+
+            case LOG_RESET:
+                this->lineRenderer->reset();
+                break;
+
+            case LOG_FRAME:
+                this->lineRenderer->frameStart();
+                break;
+
+            case LOG_LINE:
+                this->lineRenderer->renderLine(entry.address, entry.data, entry.value);
+                break;
+
+            case LOG_FENCE:
+                this->fenceDone.release();
+                break;
+
+            case LOG_STOP:
+                return;
+            }
+        }
+    }
+}
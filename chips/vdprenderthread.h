@@ -0,0 +1,95 @@
+#ifndef VDPRENDERTHREAD_H
+#define VDPRENDERTHREAD_H
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QSemaphore>
+
+#include "vdprenderer.h"
+
+#define RENDER_LOG_SIZE 0x20000
+
+struct VDPLogEntry {
+    quint8  type;
+    quint8  value;
+    quint16 address;
+    qint32  data;
+};
+
+/*
+ * Renders VDP lines on its own thread.
+ *
+ * The emulation thread records every write to the VDP memory and registers into a
+ * single producer, single consumer ring, together with a marker for every line that
+ * has to be drawn. The render thread replays them in order into its own copy of the
+ * VDP memory, so each line sees exactly the state the VDP had when it was reached.
+ */
+class VDPRenderThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum LogType {
+        LOG_VRAM,
+        LOG_CRAM,
+        LOG_VSRAM,
+        LOG_REGISTER,
+        LOG_LAYERS,
+        LOG_RESET,
+        LOG_FRAME,
+        LOG_LINE,
+        LOG_FENCE,
+        LOG_STOP,
+    };
+
+public:
+    explicit VDPRenderThread(VDPRenderer* renderer, QObject* parent = nullptr);
+    ~VDPRenderThread();
+
+    VDPRenderer*    renderer() const;
+
+    inline void write(LogType type, quint16 address, quint8 value) {
+        this->push(VDPLogEntry{ static_cast<quint8>(type), value, address, 0 });
+    }
+
+    // Layer toggles reach the renderer in order with the writes, it is never touched directly
+    void            setLayers(bool planeA, bool planeB, bool window, bool sprites);
+
+    void            frameStart();
+    void            line(int row, int y, bool vBlank);
+
+    // Blocks until every queued entry has been replayed
+    void            fence();
+
+protected:
+    void            run() override;
+
+private:
+    inline void push(const VDPLogEntry& entry) {
+        int head = this->head.load();
+        int next = (head + 1) & (RENDER_LOG_SIZE - 1);
+
+        // The ring is full, wake the render thread and wait until it drained some entries
+        if (next == this->tail.loadAcquire()) {
+            this->pending.release();
+
+            while (next == this->tail.loadAcquire())
+                QThread::yieldCurrentThread();
+        }
+
+        this->log[head] = entry;
+        this->head.storeRelease(next);
+    }
+
+private:
+    VDPRenderer*    lineRenderer;
+    VDPLogEntry*    log;
+
+    QAtomicInt      head;
+    QAtomicInt      tail;
+
+    QSemaphore      pending;
+    QSemaphore      fenceDone;
+};
+
+#endif // VDPRENDERTHREAD_H
@@ -1,15 +1,27 @@
 #include "ym2612.h"
 
 #include <QDebug>
-#include <QTimer>
+#include <QAtomicInt>
 
-#include <math.h>
-#include <SDL2/SDL.h>
+#include "ym2612tables.h"
+#include "scheduler.h"
+#include "resampler.h"
+#include "audiooutput.h"
+#include "sn76489.h"
+#include "audiothread.h"
 
-//#define YM2612_CYCLES_PER_SAMPLE 158
-#define YM2612_SINE_WAVE_SAMPLES 22050
+// YM2612 clocks per native sample
+#define YM2612_CYCLES_PER_SAMPLE    144
 
-#define PI 3.14159265
+// PAL master clock
+#define YM2612_DEFAULT_CLOCK        53203424
+
+// Master cycles per count of timer A and timer B, one and sixteen samples
+#define YM2612_TIMER_A_CYCLES       (YM2612_CYCLES_PER_SAMPLE * YM2612_DIVIDER)
+#define YM2612_TIMER_B_CYCLES       (YM2612_TIMER_A_CYCLES * 16)
+
+// Master cycles a data write keeps the chip busy, 32 internal cycles of 6 clocks
+#define YM2612_BUSY_CYCLES          (32 * 6 * YM2612_DIVIDER)
 
 // See http://www.smspower.org/maxim/Documents/YM2612
 
@@ -41,40 +53,61 @@ enum Register {
 };
 
 enum OPERATOR_STATE {
-    OP_STATE_OFF,
+    OP_STATE_RELEASE,
     OP_STATE_ATTACK,
-    OP_STATE_SUSTAIN,
     OP_STATE_DECAY,
+    OP_STATE_SUSTAIN,
 };
 
+// Six channels padded to eight lanes, so the lane loops map onto vector registers
+#define YM2612_LANES                8
+
+// Native samples rendered at most at once
+#define YM2612_BLOCK_SAMPLES        128
+
+/*
+ * Operators are kept in register order (S1, S3, S2, S4) and hold the register fields
+ * and envelope state. Phase steps and rates depend on the key code of the channel,
+ * they are recomputed before the next sample once a channel is marked dirty.
+ */
 struct Operator {
     int         state;
-    int         totalLevel;
-    int         algorithm;
-    double      phase;
-    double      frequency;
-    double      envelopeScale;
-    double      envelope;
-    double      feedback;
-    double      out;
-    double      amplitude;
-    bool        am;
-    quint8      ar;
-    quint8      rs;
-    quint8      d1r;
-    quint8      d2r;
-    quint8      t1l;
-    quint8      rr;
-    int         step;
+    int         sustainLevel;
+    quint8      rate[4];
+
+    // Raw register fields
+    quint8      detune;
+    quint8      multiple;
+    quint8      keyScale;
+    quint8      attackRate;
+    quint8      decayRate;
+    quint8      sustainRate;
+    quint8      releaseRate;
 };
 
 struct Channel {
     Operator    op[4];
-    double      frequency;
-    double      out;
+
+    quint16     frequency;  // Block and F-Number as BBBFFFFFFFFFFF
+    quint8      algorithm;
+    quint8      feedbackLevel;
 };
 
-const double YM2612_OCTAVES[] = { 32.7, 65.41, 130.81, 261.63, 523.25, 1046.50, 2093.00, 4186.01 };
+/*
+ * Per sample state of one operator (S1 to S4) for all channels.
+ * The phase is a 20 bit accumulator whose upper 10 bits address the sine,
+ * the attenuation is 10 bit with 0 being the loudest.
+ */
+struct OperatorLanes {
+    quint32     phase[YM2612_LANES];
+    quint32     phaseStep[YM2612_LANES];
+    int         attenuation[YM2612_LANES];
+    int         totalLevel[YM2612_LANES];
+    int         out[YM2612_LANES];
+};
+
+// Register index of S1 to S4 and the other way round
+static const int YM2612Slot[4] = { 0, 2, 1, 3 };
 
 class YM2612Private {
 public:
@@ -85,43 +118,93 @@ public:
     quint8  partISelect;
     quint8  partIISelect;
 
-    int     timerA;
-    int     timerB;
+    // Timer periods and the next overflow of a running timer, in master cycles
+    qint64  timerAPeriod;
+    qint64  timerBPeriod;
+    qint64  timerAExpiry;
+    qint64  timerBExpiry;
+
+    // Master cycles the last DAC write was made at and keeps the chip busy until. The Z80
+    // runs after the 68k, a write the 68k made later in the slice must not read as busy yet
+    qint64  busySince;
+    qint64  busyUntil;
 
-    double  timerAState;
-    double  timerBState;
+    Scheduler*      scheduler;
+    AudioThread*    thread;
 
-    SDL_AudioDeviceID   audioDevice;
-    SDL_AudioSpec       audioSpec;
+    // Master clock requested by the emulation thread, picked up before the next block
+    QAtomicInt      masterClock;
 
-    double      currentCycles;
-    double      cyclesPerSample;
-    qint16*     buffer;
-    int         bufferPos;
+    // Everything below is only touched by the audio thread
+    AudioOutput*    audio;
+    SN76489*        psg;
+
+    // YM2612 cycles not rendered yet
+    int         currentCycles;
+    long        clockRate;
+
+    // Native samples are band-limited to the rate of the audio device
+    Resampler   resampler;
+    qint16      resampled[(YM2612_BLOCK_SAMPLES * 4 + 1) * 2];
 
-    float       waveform[1024];
     Channel     channel[6];
+    quint8      dirtyChannels;
+    quint8      channel3Mode;
+
+    // Channel 3 special mode frequencies of S1, S3 and S2
+    quint16     specialFrequency[3];
 
-    QTimer      frequencyDebugTimer;
-    int         samplesQueued;
-    double      sampleStepRate;
+    // The upper frequency bytes only take effect with the write to the lower byte
+    quint8      frequencyLatch;
+    quint8      specialFrequencyLatch;
 
-    double      sineWave[YM2612_SINE_WAVE_SAMPLES];
+    bool        dacEnabled;
+    int         dacOut;
+
+    OperatorLanes   operators[4];
+
+    // Masks selecting the modulators of S2 to S4 and the carriers, all bits set or clear
+    int         modulation[3][3][YM2612_LANES];
+    int         carrier[4][YM2612_LANES];
+    int         left[YM2612_LANES];
+    int         right[YM2612_LANES];
+
+    // Previous S1 output and the shift of its feedback, 0 disables feedback
+    int         feedback[YM2612_LANES];
+    int         feedbackShift[YM2612_LANES];
+
+    qint16      samples[YM2612_BLOCK_SAMPLES * 2];
+
+    quint32     envelopeCounter;
+    int         envelopeDivider;
 
 public:
     YM2612Private(YM2612* q)
         : q_ptr(q),
+          status(0),
           partISelect(0),
           partIISelect(0),
-          timerA(0),
-          timerB(0),
-          timerAState(0),
-          timerBState(0),
-          audioDevice(0),
+          timerAPeriod(1024 * YM2612_TIMER_A_CYCLES),
+          timerBPeriod(256 * YM2612_TIMER_B_CYCLES),
+          timerAExpiry(0),
+          timerBExpiry(0),
+          busySince(0),
+          busyUntil(0),
+          scheduler(nullptr),
+          thread(nullptr),
+          masterClock(YM2612_DEFAULT_CLOCK),
+          audio(nullptr),
+          psg(nullptr),
           currentCycles(0),
-          cyclesPerSample(0),
-          bufferPos(0),
-          samplesQueued(0)
+          clockRate(0),
+          dirtyChannels(0x3F),
+          channel3Mode(0),
+          frequencyLatch(0),
+          specialFrequencyLatch(0),
+          dacEnabled(false),
+          dacOut(0),
+          envelopeCounter(0),
+          envelopeDivider(0)
     {
         this->registersPartI    = reinterpret_cast<quint8*>(malloc(0x100));
         this->registersPartII   = reinterpret_cast<quint8*>(malloc(0x100));
@@ -130,234 +213,482 @@ public:
         memset(this->registersPartI, 0, 0x100);
         memset(this->registersPartII, 0, 0x100);
 
-        // Calculate Sine Wave
-        for(int i=0; i < YM2612_SINE_WAVE_SAMPLES; i++) {
-            this->sineWave[i] = sin((static_cast<double>(i) / YM2612_SINE_WAVE_SAMPLES) * 360.0 * PI / 180.0);
+        this->setClockRate(YM2612_DEFAULT_CLOCK);
+
+        memset(&this->channel, 0, sizeof(this->channel));
+        memset(&this->specialFrequency, 0, sizeof(this->specialFrequency));
+        memset(&this->operators, 0, sizeof(this->operators));
+        memset(&this->modulation, 0, sizeof(this->modulation));
+        memset(&this->carrier, 0, sizeof(this->carrier));
+        memset(&this->feedback, 0, sizeof(this->feedback));
+        memset(&this->feedbackShift, 0, sizeof(this->feedbackShift));
+
+        for (int c = 0; c < YM2612_LANES; c++) {
+            for (int s = 0; s < 4; s++)
+                this->operators[s].attenuation[c] = 0x3FF;
+
+            // Both speakers are enabled on power on, the padding lanes stay silent
+            this->left[c] = c < 6 ? -1 : 0;
+            this->right[c] = c < 6 ? -1 : 0;
+            this->setAlgorithm(c, 0);
         }
+    }
 
-        // Open audio device
-        SDL_AudioSpec spec;
-        memset(&spec, 0, sizeof(SDL_AudioSpec));
+    ~YM2612Private() {
+        free(this->registersPartI);
+        free(this->registersPartII);
+    }
 
-        spec.freq = 44100;
-        spec.format = AUDIO_S16SYS;
-        spec.channels = 2;
-        spec.samples = 512;
+    // Output of an operator for a 10 bit phase and 10 bit attenuation, 14 bit signed
+    static int operatorOutput(quint32 phase, int attenuation) {
+        quint32 index = phase & 0xFF;
 
-        this->audioDevice = SDL_OpenAudioDevice(nullptr, 0, &spec, &this->audioSpec, 0);
+        if (phase & 0x100)
+            index ^= 0xFF;
 
-        if(this->audioDevice > 0) {
-            this->buffer = reinterpret_cast<qint16*>(malloc(this->audioSpec.size));
-            this->cyclesPerSample = 7600489.0 / spec.freq; // Only works for PAL
-            this->sampleStepRate = this->cyclesPerSample / 7600489.0;
+        int level = YM2612LogSin.value[index] + (attenuation << 2);
 
-            qDebug() << "Audio initialized!";
-            qDebug() << "Buffer Size" << this->audioSpec.size;
-            qDebug() << "Frequency" << this->audioSpec.freq;
-            qDebug() << "Samples" << this->audioSpec.samples;
-            qDebug() << "Cycles per sample" << this->cyclesPerSample;
-            SDL_PauseAudioDevice(this->audioDevice, 0);
-        } else {
-            this->audioDevice = 0;
-        }
+        if (level > 0x1FFF)
+            level = 0x1FFF;
 
-        // Compute basic waveform
-        for(int i=0; i < 1024; i++) {
-            double degree = (i / 1024.0) * 360.0;
-            double radian = degree * M_PI / 180;
+        int out = ((YM2612Exp.value[(level & 0xFF) ^ 0xFF] | 0x400) << 2) >> (level >> 8);
 
-            this->waveform[i] = static_cast<float>(sin(radian));
-        }
+        return phase & 0x200 ? -out : out;
+    }
 
-        memset(&this->channel, 0, sizeof(Channel) * 6);
+    // Block and the upper frequency bits select the key code used for detune and rate scaling
+    static int keyCode(int fnum, int block) {
+        bool f11 = fnum & 0x400;
+        bool low = f11 ? (fnum & 0x380) != 0 : (fnum & 0x380) == 0x380;
 
-        this->frequencyDebugTimer.setInterval(1000);
-        //this->frequencyDebugTimer.start();
+        return (block << 2) | (f11 << 1) | low;
     }
 
-    ~YM2612Private() {
-        free(this->registersPartI);
-        free(this->registersPartII);
+    static quint32 phaseStep(int fnum, int block, int detune, int multiple) {
+        int keycode = keyCode(fnum, block);
+        int offset = YM2612Detune[keycode][detune & 0x3];
 
-        if (this->audioDevice)
-            SDL_CloseAudioDevice(this->audioDevice);
+        int step = ((fnum << 1) << block) >> 2;
+        step += detune & 0x4 ? -offset : offset;
+        step &= 0x1FFFF;
+
+        return (step * (multiple ? multiple * 2 : 1)) >> 1;
     }
 
-    void updateOperator(int channel, int op, double fm) {
-        Operator* opp = &this->channel[channel].op[op];
+    static int effectiveRate(int rate, int keycode, int keyScale) {
+        if (rate == 0)
+            return 0;
+
+        return qMin(63, rate * 2 + (keycode >> (3 - keyScale)));
+    }
 
-        opp->out = this->sineWave[static_cast<int>(floor(opp->phase * YM2612_SINE_WAVE_SAMPLES)) - 1];
-        opp->out *= opp->amplitude / 127.0;
-        opp->out *= opp->totalLevel / 127.0;
+    void setAlgorithm(int c, int algorithm) {
+        const YM2612Algorithm& connections = YM2612Algorithms[algorithm];
 
-        opp->phase += (opp->frequency * this->sampleStepRate) + fm;
+        for (int s = 0; s < 3; s++) {
+            for (int m = 0; m < 3; m++)
+                this->modulation[s][m][c] = connections.modulators[s] & (1 << m) ? -1 : 0;
+        }
 
-        if (opp->phase > 1 || opp->phase < 0)
-            opp->phase -= floor(opp->phase);
+        for (int s = 0; s < 4; s++)
+            this->carrier[s][c] = connections.carriers & (1 << s) ? -1 : 0;
     }
 
-    void updateEnvelope(int channel, int op) {
-        switch(this->channel[channel].op[op].state) {
-        case OP_STATE_ATTACK:
-            if (this->channel[channel].op[op].ar)
-                this->channel[channel].op[op].amplitude += this->channel[channel].op[op].ar;
-            else
-                this->channel[channel].op[op].amplitude = 127;
+    // Decodes a channel or operator register (0x30 - 0xB6) of part 0 or 1
+    void writeRegister(int part, quint8 address, quint8 val) {
+        int index = address & 0x03;
+
+        if (index == 3)
+            return;
+
+        int c = part * 3 + index;
+        Channel* channel = &this->channel[c];
 
-            if (this->channel[channel].op[op].amplitude >= 127)
-                this->channel[channel].op[op].state = OP_STATE_SUSTAIN;
+        if (address < 0xA0) {
+            // Operator registers are ordered S1, S3, S2, S4
+            int slot = (address >> 2) & 0x03;
+            Operator* op = &channel->op[slot];
+
+            switch (address & 0xF0) {
+            case 0x30:
+                op->detune = (val >> 4) & 0x07;
+                op->multiple = val & 0x0F;
+                break;
+
+            case 0x40:
+                this->operators[YM2612Slot[slot]].totalLevel[c] = (val & 0x7F) << 3;
+                return;
+
+            case 0x50:
+                op->keyScale = val >> 6;
+                op->attackRate = val & 0x1F;
+                break;
+
+            case 0x60:
+                op->decayRate = val & 0x1F;
+                break;
+
+            case 0x70:
+                op->sustainRate = val & 0x1F;
+                break;
+
+            case 0x80:
+                op->sustainLevel = (val >> 4) == 15 ? 0x3E0 : (val >> 4) << 5;
+                op->releaseRate = val & 0x0F;
+                break;
+
+            default:
+                // SSG-EG is not emulated
+                return;
+            }
+
+            this->dirtyChannels |= 1 << c;
+            return;
+        }
+
+        switch (address & 0xFC) {
+        case 0xA0:
+            channel->frequency = (this->frequencyLatch << 8) | val;
+            this->dirtyChannels |= 1 << c;
             break;
 
-        case OP_STATE_SUSTAIN:
-            this->channel[channel].op[op].amplitude -= this->channel[channel].op[op].d1r;
-            if (this->channel[channel].op[op].amplitude <= this->channel[channel].op[op].t1l) {
-                this->channel[channel].op[op].state = OP_STATE_DECAY;
-                this->channel[channel].op[op].amplitude = this->channel[channel].op[op].t1l;
+        case 0xA4:
+            this->frequencyLatch = val & 0x3F;
+            break;
+
+        case 0xA8:
+            if (part == 0) {
+                // A8 sets S3, A9 S1 and AA S2
+                static const int slot[3] = { 1, 0, 2 };
+
+                this->specialFrequency[slot[index]] = (this->specialFrequencyLatch << 8) | val;
+                this->dirtyChannels |= 1 << 2;
             }
             break;
 
-        case OP_STATE_DECAY:
-            this->channel[channel].op[op].amplitude -= this->channel[channel].op[op].d2r;
+        case 0xAC:
+            if (part == 0)
+                this->specialFrequencyLatch = val & 0x3F;
             break;
 
-        case OP_STATE_OFF:
-            this->channel[channel].op[op].amplitude -= this->channel[channel].op[op].rr;
+        case 0xB0:
+            channel->algorithm = val & 0x07;
+            channel->feedbackLevel = (val >> 3) & 0x07;
+
+            this->setAlgorithm(c, channel->algorithm);
+            this->feedbackShift[c] = channel->feedbackLevel ? 10 - channel->feedbackLevel : 0;
+            break;
+
+        case 0xB4:
+            this->left[c] = val & 0x80 ? -1 : 0;
+            this->right[c] = val & 0x40 ? -1 : 0;
             break;
         }
+    }
 
-        if (this->channel[channel].op[op].amplitude > 127)
-            this->channel[channel].op[op].amplitude = 127;
-        else if (this->channel[channel].op[op].amplitude < 0)
-            this->channel[channel].op[op].amplitude = 0;
+    void updateParameters(int c) {
+        Channel* channel = &this->channel[c];
+        bool special = c == 2 && this->channel3Mode;
 
-        //if (this->channel[channel].op[op].amplitude)
-        //qDebug() << channel << op << this->channel[channel].op[op].state << this->channel[channel].op[op].amplitude;
+        this->dirtyChannels &= ~(1 << c);
 
-        /*
-        if (this->channel[channel].op[op].state != OP_STATE_OFF) {
-            this->channel[channel].op[op].amplitude = (127 - this->channel[channel].op[op].totalLevel) / 127.0;
-        } else {
-            this->channel[channel].op[op].amplitude = 0;
-        }*/
+        for (int o = 0; o < 4; o++) {
+            Operator* op = &channel->op[o];
+
+            // S4 always uses the channel frequency
+            int frequency = special && o < 3 ? this->specialFrequency[o] : channel->frequency;
+            int block = frequency >> 11;
+            int fnum = frequency & 0x7FF;
+            int keycode = keyCode(fnum, block);
+
+            this->operators[YM2612Slot[o]].phaseStep[c] = phaseStep(fnum, block, op->detune, op->multiple);
+
+            op->rate[OP_STATE_ATTACK]   = effectiveRate(op->attackRate, keycode, op->keyScale);
+            op->rate[OP_STATE_DECAY]    = effectiveRate(op->decayRate, keycode, op->keyScale);
+            op->rate[OP_STATE_SUSTAIN]  = effectiveRate(op->sustainRate, keycode, op->keyScale);
+            op->rate[OP_STATE_RELEASE]  = effectiveRate((op->releaseRate << 1) + 1, keycode, op->keyScale);
+        }
     }
 
-    void modulateOperators() {
+    void keyOn(int c, int slot, bool on) {
+        Operator* op = &this->channel[c].op[slot];
+        OperatorLanes* lanes = &this->operators[YM2612Slot[slot]];
+
+        if (on && op->state == OP_STATE_RELEASE) {
+            op->state = OP_STATE_ATTACK;
+            lanes->phase[c] = 0;
 
+            if (op->rate[OP_STATE_ATTACK] >= 62)
+                lanes->attenuation[c] = 0;
+        } else if (!on) {
+            op->state = OP_STATE_RELEASE;
+        }
     }
 
-    void updateChannels() {
-        for (int c=0; c < 6; c++) {
-            Channel* channel = &this->channel[c];
+    void updateEnvelope(Operator* op, int& attenuation) {
+        if (op->state == OP_STATE_ATTACK && attenuation == 0)
+            op->state = OP_STATE_DECAY;
 
-            if (c == 5 && (this->registersPartI[DACEN] & 0x80)) {
-                channel->out = (this->registersPartI[DAC] - 128.0) / 128.0; //this->registersPartI[DAC] / 255.0 - .5;
-            } else {
-                const quint8* registers;
+        if (op->state == OP_STATE_DECAY && attenuation >= op->sustainLevel)
+            op->state = OP_STATE_SUSTAIN;
 
-                int block;
-                int offset;
+        int rate = op->rate[op->state];
+        int shift = rate >> 2;
+        quint32 counter = this->envelopeCounter << shift;
 
-                if (c < 3)
-                    registers = this->registersPartI;
-                else
-                    registers = this->registersPartII;
+        if (counter & 0x7FF)
+            return;
 
-                block = (registers[0xA4 + c % 3] & 0x38) >> 3;
-                offset = registers[0xA0 + c % 3] | ((registers[0xA4 + c % 3] & 0x07) << 8);
+        int increment = (YM2612EnvelopeIncrement[rate] >> (4 * ((counter >> (shift <= 11 ? 11 : shift)) & 0x7))) & 0xF;
 
-                channel->frequency = offset * pow(2.0, block);
-                channel->frequency *= 8000000;
-                channel->frequency /= pow(2, 20);
-                channel->frequency /= 144;
+        if (op->state == OP_STATE_ATTACK) {
+            if (rate < 62)
+                attenuation += (~attenuation * increment) >> 4;
+        } else {
+            attenuation = qMin(0x3FF, attenuation + increment);
+        }
+    }
 
-                //channel->frequency = YM2612_OCTAVES[block] + offset;
+    // Computes one operator of every channel and advances its phase
+    void updateOperators(OperatorLanes* lanes, const int* modulation) {
+        quint32 phase[YM2612_LANES];
+        int attenuation[YM2612_LANES];
 
-                /*if (this->channel[c].op[0].state != OP_STATE_OFF)
-                    qDebug() << "CH" << c << "BLK" << block << "OFF" << offset << "FREQ" << this->channel[c].frequency;*/
+        for (int c = 0; c < YM2612_LANES; c++) {
+            phase[c] = (lanes->phase[c] >> 10) + modulation[c];
+            attenuation[c] = qMin(0x3FF, lanes->attenuation[c] + lanes->totalLevel[c]);
+            lanes->phase[c] = (lanes->phase[c] + lanes->phaseStep[c]) & 0xFFFFF;
+        }
+
+        for (int c = 0; c < 6; c++)
+            lanes->out[c] = operatorOutput(phase[c], attenuation[c]);
+    }
 
-                for (int o=0; o < 4; o++) {
-                    int multiplicator = registers[0x30 + (c % 3) + o * 4] & 0x0F;
+    // Renders the given amount of native samples into samples
+    void render(int count) {
+        for (int c = 0; c < 6; c++) {
+            if (this->dirtyChannels & (1 << c))
+                this->updateParameters(c);
+        }
 
-                    channel->op[o].frequency = channel->frequency * (multiplicator == 0 ? 0.5 : multiplicator);
-                    channel->op[o].totalLevel = 127 - registers[0x30 + (c % 3) + o * 4] & 0x7F;
-                    channel->op[o].rs = (registers[0x50 + (c % 3) + o * 4] >> 5);
-                    channel->op[o].ar = (registers[0x50 + (c % 3) + o * 4] & 0x0F << 1);
-                    channel->op[o].d1r = (registers[0x60 + (c % 3) + o * 4] & 0x0F << 1);
-                    channel->op[o].d2r = (registers[0x70 + (c % 3) + o * 4] & 0x0F << 1);
-                    channel->op[o].rr  = (registers[0x80 + (c % 3) + o * 4] & 0x0F << 1) + 1;
-                    channel->op[o].t1l = (registers[0x80 + (c % 3) + o * 4] & 0xF0 >> 4) * 8;
+        for (int i = 0; i < count; i++) {
+            // The envelope generator runs at a third of the sample rate
+            if (++this->envelopeDivider == 3) {
+                this->envelopeDivider = 0;
+                this->envelopeCounter++;
 
-                    this->updateEnvelope(c, o);
+                for (int c = 0; c < 6; c++) {
+                    for (int o = 0; o < 4; o++)
+                        this->updateEnvelope(&this->channel[c].op[o], this->operators[YM2612Slot[o]].attenuation[c]);
                 }
+            }
+
+            int modulation[YM2612_LANES];
+
+            // S1 modulates itself with the average of its last two outputs
+            for (int c = 0; c < YM2612_LANES; c++) {
+                int sum = this->operators[0].out[c] + this->feedback[c];
+
+                modulation[c] = this->feedbackShift[c] ? sum >> this->feedbackShift[c] : 0;
+                this->feedback[c] = this->operators[0].out[c];
+            }
 
-                switch(registers[0xB0 + c % 3] & 0x07) {
-                case 0:
-                    this->updateOperator(c, 0, 0);
-                    this->updateOperator(c, 2, channel->op[0].out);
-                    this->updateOperator(c, 1, channel->op[2].out);
-                    this->updateOperator(c, 3, channel->op[1].out);
-                    channel->out = channel->op[3].out;
-                    break;
-
-                case 1:
-                    this->updateOperator(c, 0, 0);
-                    this->updateOperator(c, 2, 0);
-                    this->updateOperator(c, 1, channel->op[0].out +channel->op[2].out);
-                    this->updateOperator(c, 3, channel->op[1].out);
-                    channel->out = channel->op[3].out;
-                    break;
-
-                case 2:
-                    this->updateOperator(c, 0, 0);
-                    this->updateOperator(c, 2, 0);
-                    this->updateOperator(c, 1, channel->op[2].out);
-                    this->updateOperator(c, 3, channel->op[0].out + channel->op[1].out);
-                    channel->out = channel->op[3].out;
-                    break;
-
-                case 3:
-                    this->updateOperator(c, 0, 0);
-                    this->updateOperator(c, 2, channel->op[0].out);
-                    this->updateOperator(c, 1, 0);
-                    this->updateOperator(c, 3, channel->op[2].out + channel->op[1].out);
-                    channel->out = channel->op[3].out;
-                    break;
-
-                case 4:
-                    this->updateOperator(c, 0, 0);
-                    this->updateOperator(c, 2, channel->op[0].out);
-                    this->updateOperator(c, 1, 0);
-                    this->updateOperator(c, 3, channel->op[1].out);
-                    channel->out = channel->op[2].out + channel->op[3].out;
-                    break;
-
-                case 5:
-                    this->updateOperator(c, 0, 0);
-                    this->updateOperator(c, 2, channel->op[0].out);
-                    this->updateOperator(c, 1, channel->op[0].out);
-                    this->updateOperator(c, 3, channel->op[0].out);
-                    channel->out = channel->op[1].out + channel->op[2].out + channel->op[3].out;
-                    break;
-
-                case 6:
-                    this->updateOperator(c, 0, 0);
-                    this->updateOperator(c, 2, 0);
-                    this->updateOperator(c, 1, channel->op[0].out);
-                    this->updateOperator(c, 3, 0);
-                    channel->out = channel->op[1].out + channel->op[2].out + channel->op[3].out;
-                    break;
-
-                case 7:
-                    this->updateOperator(c, 0, 0);
-                    this->updateOperator(c, 2, 0);
-                    this->updateOperator(c, 1, 0);
-                    this->updateOperator(c, 3, 0);
-                    channel->out = channel->op[0].out + channel->op[1].out + channel->op[2].out + channel->op[3].out;
-                    break;
+            this->updateOperators(&this->operators[0], modulation);
+
+            for (int s = 1; s < 4; s++) {
+                const int (*modulators)[YM2612_LANES] = this->modulation[s - 1];
+
+                for (int c = 0; c < YM2612_LANES; c++) {
+                    modulation[c] = ((this->operators[0].out[c] & modulators[0][c])
+                                   + (this->operators[1].out[c] & modulators[1][c])
+                                   + (this->operators[2].out[c] & modulators[2][c])) >> 1;
                 }
 
+                this->updateOperators(&this->operators[s], modulation);
             }
+
+            int out[YM2612_LANES];
+
+            // Each channel outputs 9 bit
+            for (int c = 0; c < YM2612_LANES; c++) {
+                int sum = (this->operators[0].out[c] & this->carrier[0][c])
+                        + (this->operators[1].out[c] & this->carrier[1][c])
+                        + (this->operators[2].out[c] & this->carrier[2][c])
+                        + (this->operators[3].out[c] & this->carrier[3][c]);
+
+                out[c] = qBound(-8192, sum, 8191) >> 5;
+            }
+
+            if (this->dacEnabled)
+                out[5] = this->dacOut;
+
+            int left = 0;
+            int right = 0;
+
+            for (int c = 0; c < YM2612_LANES; c++) {
+                left += out[c] & this->left[c];
+                right += out[c] & this->right[c];
+            }
+
+            // Six 9 bit channels stay within 16 bit
+            this->samples[i * 2 + 0] = static_cast<qint16>(left << 4);
+            this->samples[i * 2 + 1] = static_cast<qint16>(right << 4);
+        }
+    }
+
+    void setClockRate(long masterClock) {
+        this->clockRate = masterClock / YM2612_DIVIDER;
+
+        if (this->audio && this->audio->isOpen())
+            this->resampler.setRates(static_cast<double>(this->clockRate) / YM2612_CYCLES_PER_SAMPLE, this->audio->frequency());
+    }
+
+    // Passes rendered samples on to the audio output
+    void output(int count) {
+        if (!this->audio || !this->audio->isOpen())
+            return;
+
+        this->resampler.setAdjustment(this->audio->rateAdjustment());
+
+        int frames = this->resampler.process(this->samples, count, this->resampled);
+
+        // Frames that do not fit are dropped by the output
+        this->audio->write(this->resampled, frames);
+    }
+
+    // Renders every complete sample up to the current cycle
+    void flush() {
+        int masterClock = this->masterClock.loadAcquire();
+
+        if (masterClock / YM2612_DIVIDER != this->clockRate)
+            this->setClockRate(masterClock);
+
+        while (this->currentCycles >= YM2612_CYCLES_PER_SAMPLE) {
+            int count = qMin(YM2612_BLOCK_SAMPLES, this->currentCycles / YM2612_CYCLES_PER_SAMPLE);
+
+            this->render(count);
+
+            if (this->psg)
+                this->psg->mix(this->samples, count);
+
+            this->output(count);
+
+            this->currentCycles -= count * YM2612_CYCLES_PER_SAMPLE;
+        }
+    }
+
+    // Applies a register write to the synthesis state
+    void write(int part, quint8 address, quint8 val) {
+        // Samples up to now are rendered with the old register state
+        this->flush();
+
+        if (address >= 0x30) {
+            this->writeRegister(part, address, val);
+            return;
+        }
+
+        if (part)
+            return;
+
+        switch (address) {
+        case TIMER_MODE:
+            // Entering or leaving channel 3 special mode changes its frequencies
+            this->channel3Mode = val & YM2612_CH3_MODE;
+            this->dirtyChannels |= 1 << 2;
+            break;
+
+        case DAC:
+            this->dacOut = (val - 128) << 1;
+            break;
+
+        case DACEN:
+            this->dacEnabled = val & 0x80;
+            break;
+
+        case KEYSTATE: {
+            // Channels 0-2 are selected by 0-2, channels 3-5 by 4-6
+            if ((val & 0x03) == 0x03)
+                break;
+
+            int c = (val & 0x03) + (val & 0x04 ? 3 : 0);
+
+            if (this->dirtyChannels & (1 << c))
+                this->updateParameters(c);
+
+            this->keyOn(c, 0, val & 0x10);
+            this->keyOn(c, 2, val & 0x20);
+            this->keyOn(c, 1, val & 0x40);
+            this->keyOn(c, 3, val & 0x80);
+            break;
         }
+        }
+    }
+
+    qint64 now() const {
+        return this->scheduler ? this->scheduler->timestamp() : 0;
+    }
+
+    // First overflow of a timer after the given cycle
+    static qint64 nextExpiry(qint64 expiry, qint64 period, qint64 cycle) {
+        if (expiry > cycle)
+            return expiry;
+
+        return expiry + ((cycle - expiry) / period + 1) * period;
+    }
+
+    // Sets the flags of every overflow up to the given cycle, nothing runs in between
+    void updateTimers(qint64 cycle) {
+        quint8 mode = this->registersPartI[TIMER_MODE];
+
+        if ((mode & YM2612_LOAD_A) && cycle >= this->timerAExpiry) {
+            this->timerAExpiry = nextExpiry(this->timerAExpiry, this->timerAPeriod, cycle);
+
+            if (mode & YM2612_ENABLE_A)
+                this->status |= YM2612_OVERFLOW_A;
+        }
+
+        if ((mode & YM2612_LOAD_B) && cycle >= this->timerBExpiry) {
+            this->timerBExpiry = nextExpiry(this->timerBExpiry, this->timerBPeriod, cycle);
+
+            if (mode & YM2612_ENABLE_B)
+                this->status |= YM2612_OVERFLOW_B;
+        }
+    }
+
+    // Timer registers 0x24 - 0x27, a new period is used from the next reload on
+    void writeTimers(quint8 address, quint8 val) {
+        qint64 cycle = this->now();
+        quint8 mode = this->registersPartI[TIMER_MODE];
+
+        this->updateTimers(cycle);
+        this->registersPartI[address] = val;
+
+        this->timerAPeriod = (1024 - ((this->registersPartI[TIMER_A_MSB] << 2) | (this->registersPartI[TIMER_A_LSB] & 0x03))) * YM2612_TIMER_A_CYCLES;
+        this->timerBPeriod = (256 - this->registersPartI[TIMER_B]) * YM2612_TIMER_B_CYCLES;
+
+        if (address != TIMER_MODE)
+            return;
+
+        // Setting a load bit starts counting from the period, a running timer keeps going
+        if ((val & YM2612_LOAD_A) && !(mode & YM2612_LOAD_A))
+            this->timerAExpiry = cycle + this->timerAPeriod;
+
+        if ((val & YM2612_LOAD_B) && !(mode & YM2612_LOAD_B))
+            this->timerBExpiry = cycle + this->timerBPeriod;
+
+        if (val & YM2612_RESET_A)
+            this->status &= ~YM2612_OVERFLOW_A;
+
+        if (val & YM2612_RESET_B)
+            this->status &= ~YM2612_OVERFLOW_B;
+    }
+
+    // Passes a register write on to the audio thread, or applies it right away without one
+    void submit(int part, quint8 address, quint8 val) {
+        if (this->thread)
+            this->thread->write(part ? AudioThread::LOG_YM2612_PART_II : AudioThread::LOG_YM2612_PART_I, address, val);
+        else
+            this->write(part, address, val);
     }
 
 private:
@@ -369,9 +700,7 @@ YM2612::YM2612(QObject *parent)
     : QObject(parent),
       d_ptr(new YM2612Private(this))
 {
-    Q_D(YM2612);
 
-    QObject::connect(&d->frequencyDebugTimer, &QTimer::timeout, this, &YM2612::reportSampleFrequency);
 }
 
 YM2612::~YM2612()
@@ -384,7 +713,16 @@ int YM2612::peek(quint32 address, quint8 &val)
     Q_D(YM2612);
     Q_UNUSED(address);
 
+    qint64 cycle = d->now();
+
+    // The flags are only worked out when they are read
+    d->updateTimers(cycle);
+
     val = d->status;
+
+    if (cycle >= d->busySince && cycle < d->busyUntil)
+        val |= YM2612_BUSY;
+
     return NO_ERROR;
 }
 
@@ -404,50 +742,17 @@ int YM2612::poke(quint32 address, quint8 val)
         break;
 
     case 0x4001:
-        d->registersPartI[d->partISelect] = val;
-
-        switch(d->partISelect) {
-        case TIMER_MODE:
-            if (val & YM2612_LOAD_A) {
-                d->timerA = 18 * (1024 - ((d->registersPartI[TIMER_A_MSB] << 2) | d->registersPartI[TIMER_A_LSB]));
-                d->timerAState = floor(d->timerA * 136.8);
-            } else {
-                d->timerA = 0;
-                d->timerAState = 0;
-            }
-
-            if (val & YM2612_LOAD_B) {
-                d->timerB = 288 * (256 - d->registersPartI[TIMER_B]);
-                d->timerBState = floor(d->timerB * 136.8);
-            } else {
-                d->timerB = 0;
-                d->timerBState = 0;
-            }
-
-            if (val & YM2612_RESET_A) {
-                d->status &= ~YM2612_OVERFLOW_A;
-            }
-
-            if (val & YM2612_RESET_B)
-                d->status &= ~YM2612_OVERFLOW_B;
-
-            break;
-
-        case DAC:
-            d->status |= YM2612_BUSY;
-            break;
-
-        case DACEN:
-            break;
-
-        case KEYSTATE:
-            d->channel[val & 0x7].op[0].state = val & 0x10 ? OP_STATE_ATTACK : OP_STATE_OFF;
-            d->channel[val & 0x7].op[1].state = val & 0x20 ? OP_STATE_ATTACK : OP_STATE_OFF;
-            d->channel[val & 0x7].op[2].state = val & 0x40 ? OP_STATE_ATTACK : OP_STATE_OFF;
-            d->channel[val & 0x7].op[3].state = val & 0x80 ? OP_STATE_ATTACK : OP_STATE_OFF;
-            break;
+        if (d->partISelect >= TIMER_A_MSB && d->partISelect <= TIMER_MODE)
+            d->writeTimers(d->partISelect, val);
+        else
+            d->registersPartI[d->partISelect] = val;
+
+        if (d->partISelect == DAC) {
+            d->busySince = d->now();
+            d->busyUntil = d->busySince + YM2612_BUSY_CYCLES;
         }
 
+        d->submit(0, d->partISelect, val);
         break;
 
     case 0x4002:
@@ -456,6 +761,7 @@ int YM2612::poke(quint32 address, quint8 val)
 
     case 0x4003:
         d->registersPartII[d->partIISelect] = val;
+        d->submit(1, d->partIISelect, val);
         break;
 
     default:
@@ -466,75 +772,78 @@ int YM2612::poke(quint32 address, quint8 val)
     return NO_ERROR;
 }
 
-void YM2612::clock(int cycles) {
+void YM2612::attachScheduler(Scheduler* scheduler)
+{
     Q_D(YM2612);
 
-    d->currentCycles += cycles;
+    d->scheduler = scheduler;
+}
 
-    while (d->currentCycles > 0) {
-        int samplePos = d->bufferPos * 2;
-        float sample = 0;
+qint64 YM2612::nextOverflow() const
+{
+    Q_D(const YM2612);
 
-        d->updateChannels();
-        d->modulateOperators();
+    quint8 mode = d->registersPartI[TIMER_MODE];
+    qint64 cycle = d->now();
+    qint64 next = -1;
 
-        for (int c=0; c < 6; c++) {
-            sample += d->channel[c].out;
-        }
+    if ((mode & YM2612_LOAD_A) && (mode & YM2612_ENABLE_A))
+        next = d->nextExpiry(d->timerAExpiry, d->timerAPeriod, cycle);
 
-        // Limit signal
-        if (sample > 1)
-            sample = 1;
+    if ((mode & YM2612_LOAD_B) && (mode & YM2612_ENABLE_B)) {
+        qint64 expiry = d->nextExpiry(d->timerBExpiry, d->timerBPeriod, cycle);
 
-        if (sample < -1)
-            sample = -1;
+        if (next < 0 || expiry < next)
+            next = expiry;
+    }
 
-        d->buffer[samplePos + 0] = static_cast<qint16>(sample * 0x7FFF); // L
-        d->buffer[samplePos + 1] = static_cast<qint16>(sample * 0x7FFF); // R
+    return next;
+}
 
-        d->samplesQueued++;
+void YM2612::attachAudioThread(AudioThread* thread)
+{
+    Q_D(YM2612);
 
-        d->bufferPos+=1;
-        if (d->bufferPos >= d->audioSpec.samples) {
-            //qDebug() << SDL_GetQueuedAudioSize(d->audioDevice) << d->audioSpec.size;
+    d->thread = thread;
+}
 
-            // Just Queue Audio if the Buffer consumed. Else, we just drop the audio
-            if (SDL_GetQueuedAudioSize(d->audioDevice) < (d->audioSpec.size * 3))
-                SDL_QueueAudio(d->audioDevice, d->buffer, d->audioSpec.size);
+void YM2612::write(int part, quint8 address, quint8 val)
+{
+    Q_D(YM2612);
 
-            d->bufferPos = 0;
-        }
+    d->write(part, address, val);
+}
 
-        if (d->timerAState > 0) {
-            d->timerAState -= d->cyclesPerSample;
-            if (d->timerAState <= 0) {
-                if (d->registersPartI[TIMER_MODE] & YM2612_ENABLE_A)
-                    d->status |= YM2612_OVERFLOW_A;
+void YM2612::synthesize(int cycles)
+{
+    Q_D(YM2612);
 
-                d->timerAState = floor(d->timerA * 136.8);
-            }
-        }
+    // Samples are rendered in blocks once enough are due or before the next register write
+    d->currentCycles += cycles;
 
-        if (d->timerBState > 0) {
-            d->timerBState -= d->cyclesPerSample;
-            if (d->timerBState <= 0) {
-                if (d->registersPartI[TIMER_MODE] & YM2612_ENABLE_B)
-                    d->status |= YM2612_OVERFLOW_B;
+    if (d->currentCycles >= YM2612_BLOCK_SAMPLES * YM2612_CYCLES_PER_SAMPLE)
+        d->flush();
+}
 
-                d->timerBState = floor(d->timerB * 136.8);
-                //qDebug() << "YM2612 TIMER B OVERFLOW";
-            }
-        }
+void YM2612::attachAudioOutput(AudioOutput* audio)
+{
+    Q_D(YM2612);
 
-        d->status &= ~YM2612_BUSY;
+    d->audio = audio;
+    d->resampler.reset();
+    d->setClockRate(d->masterClock.loadAcquire());
+}
 
-        d->currentCycles -= d->cyclesPerSample;
-    }
+void YM2612::attachPsg(SN76489* psg)
+{
+    Q_D(YM2612);
+
+    d->psg = psg;
 }
 
-void YM2612::reportSampleFrequency() {
+void YM2612::setClockRate(long masterClock)
+{
     Q_D(YM2612);
 
-    qDebug() << "YM2612 FREQUENCY" << d->samplesQueued;
-    d->samplesQueued = 0;
+    d->masterClock.storeRelease(static_cast<int>(masterClock));
 }
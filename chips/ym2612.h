@@ -4,6 +4,11 @@
 #include <QObject>
 #include <memorybus.h>
 
+class Scheduler;
+class AudioOutput;
+class AudioThread;
+class SN76489;
+
 class YM2612Private;
 class YM2612
         : public QObject,
@@ -17,10 +22,27 @@ public:
     int     peek(quint32 address, quint8& val);
     int     poke(quint32 address, quint8 val);
 
-    void    clock(int cycles);
+    // Timer and busy flags are derived from the current master cycle when read
+    void    attachScheduler(Scheduler* scheduler);
+
+    // Master cycle (see Scheduler::timestamp()) of the next overflow that raises a flag, -1 if none
+    qint64  nextOverflow() const;
+
+    // Not owned, register writes are passed on to the audio thread, which synthesizes
+    void    attachAudioThread(AudioThread* thread);
+
+    // Synthesis, on the audio thread
+    void    write(int part, quint8 address, quint8 val);
+    void    synthesize(int cycles);
+
+    // Not owned, samples are dropped without an output. Only while the audio thread is stopped
+    void    attachAudioOutput(AudioOutput* audio);
+
+    // Not owned, the PSG output is mixed into the native samples before resampling
+    void    attachPsg(SN76489* psg);
 
-public slots:
-    void    reportSampleFrequency();
+    // Master clock in Hz, the audio output is resampled from the resulting native rate
+    void    setClockRate(long masterClock);
 
 private:
     YM2612Private* d_ptr;
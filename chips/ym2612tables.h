@@ -0,0 +1,142 @@
+#ifndef YM2612TABLES_H
+#define YM2612TABLES_H
+
+#include <QtGlobal>
+
+/*
+ * ROM tables of the YM2612 operator and envelope generator, built at compile time.
+ *
+ * The operator works in the log domain: YM2612LogSin holds -log2(sin) of a quarter
+ * sine wave as 4.8 fixed point, the attenuation is added to it and YM2612Exp turns
+ * the sum back into a linear 13 bit amplitude.
+ */
+
+// Compile time replacements for the libm functions, precise enough to round the same way
+constexpr double ym2612Ln2 = 0.693147180559945309417;
+constexpr double ym2612Pi  = 3.14159265358979323846;
+
+constexpr double ym2612Sin(double x) {
+    double term = x;
+    double sum = x;
+
+    for (int n = 1; n < 20; n++) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+
+    return sum;
+}
+
+constexpr double ym2612Log2(double x) {
+    int exponent = 0;
+
+    while (x < 1.0) {
+        x *= 2.0;
+        exponent--;
+    }
+
+    while (x >= 2.0) {
+        x /= 2.0;
+        exponent++;
+    }
+
+    // ln(x) = 2 * atanh((x - 1) / (x + 1))
+    double z = (x - 1.0) / (x + 1.0);
+    double term = z;
+    double sum = 0;
+
+    for (int n = 0; n < 40; n++) {
+        sum += term / (2 * n + 1);
+        term *= z * z;
+    }
+
+    return exponent + 2.0 * sum / ym2612Ln2;
+}
+
+constexpr double ym2612Exp2(double x) {
+    double term = 1.0;
+    double sum = 1.0;
+
+    for (int n = 1; n < 30; n++) {
+        term *= x * ym2612Ln2 / n;
+        sum += term;
+    }
+
+    return sum;
+}
+
+struct YM2612Table {
+    quint16 value[256];
+};
+
+constexpr YM2612Table ym2612BuildLogSin() {
+    YM2612Table table {};
+
+    for (int i = 0; i < 256; i++)
+        table.value[i] = static_cast<quint16>(-ym2612Log2(ym2612Sin((i + 0.5) * ym2612Pi / 512.0)) * 256.0 + 0.5);
+
+    return table;
+}
+
+constexpr YM2612Table ym2612BuildExp() {
+    YM2612Table table {};
+
+    for (int i = 0; i < 256; i++)
+        table.value[i] = static_cast<quint16>((ym2612Exp2(i / 256.0) - 1.0) * 1024.0 + 0.5);
+
+    return table;
+}
+
+constexpr YM2612Table YM2612LogSin   = ym2612BuildLogSin();
+constexpr YM2612Table YM2612Exp      = ym2612BuildExp();
+
+// Frequency offset per key code for DT1 = 0-3, DT1 4-7 subtract it
+constexpr quint8 YM2612Detune[32][4] = {
+    { 0, 0,  1,  2 }, { 0, 0,  1,  2 }, { 0, 0,  1,  2 }, { 0, 0,  1,  2 },
+    { 0, 1,  2,  2 }, { 0, 1,  2,  3 }, { 0, 1,  2,  3 }, { 0, 1,  2,  3 },
+    { 0, 1,  2,  4 }, { 0, 1,  3,  4 }, { 0, 1,  3,  4 }, { 0, 1,  3,  5 },
+    { 0, 2,  4,  5 }, { 0, 2,  4,  6 }, { 0, 2,  4,  6 }, { 0, 2,  5,  7 },
+    { 0, 2,  5,  8 }, { 0, 3,  6,  8 }, { 0, 3,  6,  9 }, { 0, 3,  7, 10 },
+    { 0, 4,  8, 11 }, { 0, 4,  8, 12 }, { 0, 4,  9, 13 }, { 0, 5, 10, 14 },
+    { 0, 5, 11, 16 }, { 0, 6, 12, 17 }, { 0, 6, 13, 19 }, { 0, 7, 14, 20 },
+    { 0, 8, 16, 22 }, { 0, 8, 16, 22 }, { 0, 8, 16, 22 }, { 0, 8, 16, 22 },
+};
+
+// Attenuation steps per rate, one nibble for each of the eight envelope cycles
+constexpr quint32 YM2612EnvelopeIncrement[64] = {
+    0x00000000, 0x00000000, 0x10101010, 0x10101010,
+    0x10101010, 0x10101010, 0x11101110, 0x11101110,
+    0x10101010, 0x10111010, 0x11101110, 0x11111110,
+    0x10101010, 0x10111010, 0x11101110, 0x11111110,
+    0x10101010, 0x10111010, 0x11101110, 0x11111110,
+    0x10101010, 0x10111010, 0x11101110, 0x11111110,
+    0x10101010, 0x10111010, 0x11101110, 0x11111110,
+    0x10101010, 0x10111010, 0x11101110, 0x11111110,
+    0x10101010, 0x10111010, 0x11101110, 0x11111110,
+    0x10101010, 0x10111010, 0x11101110, 0x11111110,
+    0x10101010, 0x10111010, 0x11101110, 0x11111110,
+    0x10101010, 0x10111010, 0x11101110, 0x11111110,
+    0x11111111, 0x21112111, 0x21212121, 0x22212221,
+    0x22222222, 0x42224222, 0x42424242, 0x44424442,
+    0x44444444, 0x84448444, 0x84848484, 0x88848884,
+    0x88888888, 0x88888888, 0x88888888, 0x88888888,
+};
+
+// Operators in the order they are computed, S1 to S4
+struct YM2612Algorithm {
+    quint8  modulators[3];  // Operators modulating S2, S3 and S4, bit 0 is S1
+    quint8  carriers;       // Operators summed into the output
+};
+
+constexpr YM2612Algorithm YM2612Algorithms[8] = {
+    { { 0x1, 0x2, 0x4 }, 0x8 },     // S1 > S2 > S3 > S4
+    { { 0x0, 0x3, 0x4 }, 0x8 },     // (S1 + S2) > S3 > S4
+    { { 0x0, 0x2, 0x5 }, 0x8 },     // (S1 + (S2 > S3)) > S4
+    { { 0x1, 0x0, 0x6 }, 0x8 },     // ((S1 > S2) + S3) > S4
+    { { 0x1, 0x0, 0x4 }, 0xA },     // (S1 > S2) + (S3 > S4)
+    { { 0x1, 0x1, 0x1 }, 0xE },     // S1 > (S2 + S3 + S4)
+    { { 0x1, 0x0, 0x0 }, 0xE },     // (S1 > S2) + S3 + S4
+    { { 0x0, 0x0, 0x0 }, 0xF },     // S1 + S2 + S3 + S4
+};
+
+#endif // YM2612TABLES_H
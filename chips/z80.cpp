@@ -12,12 +12,19 @@ class Z80Private {
       bool        resetting;
       int         currentCycles;
 
+      // Cycles run ahead of the current clock() call and elapsed within it
+      int         carry;
+      int         elapsed;
+
    public:
       Z80Private(Z80* q)
          : q_ptr(q),
            bus(0),
            busReq(0),
-           resetting(0)
+           resetting(0),
+           currentCycles(0),
+           carry(0),
+           elapsed(0)
       {
          memset(&this->state, 0, sizeof(Z80_STATE));
          Z80Reset(&this->state);
@@ -53,11 +60,22 @@ MemoryBus* Z80::bus()
    return d->bus;
 }
 
+MemoryBus* Z80::busAt(int elapsed)
+{
+   Q_D(Z80);
+
+   d->elapsed = elapsed;
+   return d->bus;
+}
+
 int Z80::clock(int cycles)
 {
    Q_D(Z80);
 
    if (!d->busReq && !d->resetting) {
+      d->carry = -d->currentCycles;
+      d->elapsed = 0;
+
       d->currentCycles += cycles;
       d->currentCycles -= Z80Emulate(&d->state, d->currentCycles, this);
    }
@@ -65,6 +83,13 @@ int Z80::clock(int cycles)
    return 0;
 }
 
+int Z80::cyclesRun() const
+{
+   Q_D(const Z80);
+
+   return d->carry + d->elapsed;
+}
+
 void Z80::reset()
 {
    Q_D(Z80);
@@ -19,9 +19,15 @@ class Z80
       void           attachBus(MemoryBus* bus);
       MemoryBus*     bus();
 
+      // Notes the cycles elapsed in the running clock() call before each access
+      MemoryBus*     busAt(int elapsed);
+
       // Emulation
       int            clock(int cycles);
 
+      // Cycles run since the start of the current clock() call, as of the last access
+      int            cyclesRun() const;
+
       void           reset();
       void           interrupt();
 
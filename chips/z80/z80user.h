@@ -91,7 +91,7 @@
 #define Z80_READ_BYTE(address, x)                                       \
 {                                                                       \
    quint8 v;                                                            \
-   ((Z80*) context)->bus()->peek(address & 0xffff, v);                  \
+   ((Z80*) context)->busAt(elapsed_cycles)->peek(address & 0xffff, v);  \
    (x) = v;                                                             \
    elapsed_cycles += 4; \
 }
@@ -102,8 +102,8 @@
 {                                                                       \
    quint8 v0, v1;                                                       \
 									\
-   ((Z80*) context)->bus()->peek(address & 0xffff, v0);                 \
-   ((Z80*) context)->bus()->peek((address + 1) & 0xffff, v1);           \
+   ((Z80*) context)->busAt(elapsed_cycles)->peek(address & 0xffff, v0); \
+   ((Z80*) context)->busAt(elapsed_cycles)->peek((address + 1) & 0xffff, v1); \
                            \
    x = v0 | (v1 << 8);                                                  \
    \
@@ -114,7 +114,7 @@
 
 #define Z80_WRITE_BYTE(address, x)                                      \
 {                                                                       \
-   ((Z80*) context)->bus()->poke(address & 0xffff, x);                  \
+   ((Z80*) context)->busAt(elapsed_cycles)->poke(address & 0xffff, x);  \
    elapsed_cycles += 4; \
 }
 
@@ -123,8 +123,8 @@
 
 #define Z80_WRITE_WORD(address, x)                                      \
 {                                                                       \
-   ((Z80*) context)->bus()->poke(address & 0xffff, x & 0xff);           \
-   ((Z80*) context)->bus()->poke((address + 1) & 0xffff, (x >> 8) & 0xff); \
+   ((Z80*) context)->busAt(elapsed_cycles)->poke(address & 0xffff, x & 0xff); \
+   ((Z80*) context)->busAt(elapsed_cycles)->poke((address + 1) & 0xffff, (x >> 8) & 0xff); \
    elapsed_cycles += 8; \
 }
 
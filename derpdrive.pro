@@ -6,6 +6,7 @@
 
 QT       += core gui
 #CONFIG   += console
+CONFIG   += c++14
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -44,19 +45,28 @@ SOURCES += \
     controller.cpp \
     extensionport.cpp \
     chips/vdp.cpp \
+    chips/vdpcompositor.cpp \
+    chips/vdprenderer.cpp \
+    chips/vdprenderthread.cpp \
     device.cpp \
     chips/z80.cpp \
     chips/z80/z80emu.cpp \
     vramview.cpp \
     m68kdebugger.cpp \
     chips/ym2612.cpp \
+    chips/sn76489.cpp \
     chips/m68k/m68kcpu.cpp \
     chips/m68k/m68kops.cpp \
     chips/m68k/m68kopac.cpp \
     chips/m68k/m68kopdm.cpp \
     chips/m68k/m68kopnz.cpp \
     chips/m68k/m68kdasm.cpp \
-    memorybank.cpp
+    memorybank.cpp \
+    scheduler.cpp \
+    videosink.cpp \
+    resampler.cpp \
+    audiooutput.cpp \
+    audiothread.cpp
 
 HEADERS += \
         mainwindow.h \
@@ -78,16 +88,28 @@ HEADERS += \
     controller.h \
     extensionport.h \
     chips/vdp.h \
+    chips/vdpcolor.h \
+    chips/vdpcompositor.h \
+    chips/vdpregisters.h \
+    chips/vdprenderer.h \
+    chips/vdprenderthread.h \
     device.h \
     chips/z80.h \
     vramview.h \
     m68kdebugger.h \
     chips/ym2612.h \
+    chips/ym2612tables.h \
+    chips/sn76489.h \
     chips/m68k/m68k.h \
     chips/m68k/m68kconf.h \
     chips/m68k/m68kcpu.h \
     chips/m68k/m68kops.h \
-    memorybank.h
+    memorybank.h \
+    scheduler.h \
+    videosink.h \
+    resampler.h \
+    audiooutput.h \
+    audiothread.h
 
 FORMS += \
         mainwindow.ui \
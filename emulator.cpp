@@ -11,12 +11,23 @@
 #include <chips/z80.h>
 #include <chips/vdp.h>
 #include <chips/ym2612.h>
+#include <chips/sn76489.h>
 #include <cartridge.h>
 #include <ram.h>
 #include <systemversion.h>
 #include <controller.h>
 #include <extensionport.h>
 #include <memorybank.h>
+#include <scheduler.h>
+#include <videosink.h>
+#include <audiooutput.h>
+#include <audiothread.h>
+
+// Master cycles of one scanline
+#define LINE_CYCLES 3420
+
+// Longest stretch of wall time emulated at once, anything beyond is dropped after a stall
+#define MAX_CATCH_UP_US 100000
 
 class EmulatorPrivate {
 public:
@@ -29,18 +40,26 @@ public:
     Ram*           ram;
     Ram*           soundRam;
     YM2612*        ym2612;
+    SN76489*       psg;
     SystemVersion* systemVersion;
     Controller*    controllerA;
     Controller*    controllerB;
     ExtensionPort* extensionPort;
     MemoryBank*     memoryBank;
+    Scheduler*     scheduler;
+    AudioOutput*   audio;
+    AudioThread*   audioThread;
     QTimer*        fpsTimer;
     int            cyclesCount;
     int            ymCycles;
     int            z80Cycles;
+    int            sliceCount;
     int            currentCycles;
     int            fpsCount;
     int            currentFps;
+    int            frameSkip;
+    int            frameCounter;
+    bool           frameDone;
 
     long           masterClockRate;
     long           seventhCycleCount;
@@ -52,12 +71,18 @@ public:
 public:
     EmulatorPrivate(Emulator* q)
         : q_ptr(q),
+          audio(nullptr),
+          audioThread(nullptr),
           cyclesCount(0),
           ymCycles(0),
           z80Cycles(0),
-          masterClockRate(0),
+          sliceCount(0),
+          masterClockRate(53203424),   // PAL
           fpsCount(0),
           currentFps(0),
+          frameSkip(0),
+          frameCounter(0),
+          frameDone(false),
           seventhCycleCount(0),
           fifteenthCycleCount(0),
           accumulator(0)
@@ -70,7 +95,7 @@ public:
     Q_DECLARE_PUBLIC(Emulator)
 };
 
-Emulator::Emulator(SDL_Renderer* renderer, QObject *parent)
+Emulator::Emulator(QObject *parent)
     : QObject(parent),
       d_ptr(new EmulatorPrivate(this))
 {
@@ -84,20 +109,26 @@ Emulator::Emulator(SDL_Renderer* renderer, QObject *parent)
     d->bus         = new MemoryBus(M68K_BUS_SIZE, this);
     d->z80Bus      = new MemoryBus(Z80_BUS_SIZE, this);
 
-    d->ram         = new Ram(0xFFFF, this);
-    d->soundRam    = new Ram(0x1FFF, this);
+    d->ram         = new Ram(0x10000, this);
+    d->soundRam    = new Ram(0x2000, this);
     d->cpu         = new Motorola68000(this);
     d->z80         = new Z80(this);
-    d->vdp         = new VDP(renderer, this);
+    d->vdp         = new VDP(this);
     d->ym2612      = new YM2612(this);
+    d->psg         = new SN76489(this);
     d->cartridge   = new Cartridge(this);
     d->systemVersion = new SystemVersion(this);
     d->controllerA = new Controller(0, this);
     d->controllerB = new Controller(1, this);
     d->extensionPort = new ExtensionPort(this);
     d->memoryBank   = new MemoryBank(this);
+    d->scheduler    = new Scheduler(this);
+
+    // Headless runs never initialize SDL audio, the sound chips then only keep their registers
+    if (SDL_WasInit(SDL_INIT_AUDIO))
+        d->audio    = new AudioOutput();
 
-    connect(d->vdp, &VDP::frameUpdated, this, &Emulator::updateFpsCount);
+    connect(d->vdp, &VDP::frameStarted, this, &Emulator::startFrame);
 
     /*
     * Bus Setup
@@ -106,10 +137,7 @@ Emulator::Emulator(SDL_Renderer* renderer, QObject *parent)
 
     // Setup RAM
     deviceHandle = d->bus->attachDevice(d->ram);
-    for (int i=0; i < 32; i++) {
-        int base = 0xE00000 + 0x10000*i;
-        d->bus->wire(base, base + 0xFFFF, 0x0, deviceHandle);
-    }
+    d->bus->wire(0xE00000, 0xFFFFFF, 0x0, deviceHandle, 0xFFFF);  // 64k mirrored 32 times
     //d->bus->wire(0xFF0000, 0xFFFFFF, 0x0, deviceHandle);
 
     // Setup Cardtridge Slot
@@ -124,8 +152,10 @@ Emulator::Emulator(SDL_Renderer* renderer, QObject *parent)
     d->z80Bus->wire(0x0000, 0x1FFF, 0x0, deviceHandle);
 
     deviceHandle = d->z80Bus->attachDevice(d->ym2612);
-    for (int i=0x4000; i < 0x5FFF; i += 4)
-        d->z80Bus->wire(i, i+3, 0x4000, deviceHandle);
+    d->z80Bus->wire(0x4000, 0x5FFF, 0x4000, deviceHandle, 0x3);
+
+    deviceHandle = d->z80Bus->attachDevice(d->psg);
+    d->z80Bus->wire(0x7F10, 0x7F17, 0x0, deviceHandle);
 
     deviceHandle = d->z80Bus->attachDevice(d->memoryBank->controller());
     d->z80Bus->wire(0x6000, 0x6000, 0x0, deviceHandle);
@@ -183,12 +213,13 @@ Emulator::Emulator(SDL_Renderer* renderer, QObject *parent)
     d->bus->wire(0xC0000A, 0xC0000B, 0x04, deviceHandle); // H/V Counter (Mirror)
     d->bus->wire(0xC0000C, 0xC0000D, 0x04, deviceHandle); // H/V Counter (Mirror)
     d->bus->wire(0xC0000E, 0xC0000F, 0x04, deviceHandle); // H/V Counter (Mirror)
-    d->bus->wire(0xC00011, 0xC00012, 0x06, deviceHandle); // SN76489 PSG
-    d->bus->wire(0xC00013, 0xC00014, 0x06, deviceHandle); // SN76489 PSG (Mirror)
-    d->bus->wire(0xC00015, 0xC00016, 0x06, deviceHandle); // SN76489 PSG (Mirror)
     d->bus->wire(0xC0001C, 0xC0001D, 0x08, deviceHandle); // "Disable"/Debug register
     d->bus->wire(0xC0001E, 0xC0001F, 0x08, deviceHandle); // "Disable"/Debug register (Mirror)
 
+    // Setup PSG
+    deviceHandle = d->bus->attachDevice(d->psg);
+    d->bus->wire(0xC00010, 0xC00017, 0x0, deviceHandle);  // SN76489 PSG, odd bytes only
+
     // Setup CPU
     d->cpu->attachBus(d->bus);
     d->z80->attachBus(d->z80Bus);
@@ -196,10 +227,38 @@ Emulator::Emulator(SDL_Renderer* renderer, QObject *parent)
     // Setup Interrupt Lanes
     d->vdp->attachCpu(d->cpu);
 
+    // Setup Scheduler
+    d->scheduler->attachCpu(d->cpu);
+    d->scheduler->attachZ80(d->z80);
+    d->scheduler->attachVdp(d->vdp);
+    d->scheduler->attachYm2612(d->ym2612);
+
+    // Setup Audio, nothing is synthesized without a device to play it
+    d->ym2612->attachPsg(d->psg);
+
+    if (d->audio && d->audio->isOpen()) {
+        d->ym2612->attachAudioOutput(d->audio);
+
+        d->audioThread = new AudioThread(d->scheduler, d->ym2612, d->psg, this);
+        d->ym2612->attachAudioThread(d->audioThread);
+        d->psg->attachAudioThread(d->audioThread);
+        d->scheduler->attachAudioThread(d->audioThread);
+    }
+
+    d->vdp->attachScheduler(d->scheduler);
+    d->ym2612->attachScheduler(d->scheduler);
 }
 
 Emulator::~Emulator()
 {
+    Q_D(Emulator);
+
+    // Stops synthesis before the output goes away
+    delete d->audioThread;
+
+    d->ym2612->attachAudioOutput(nullptr);
+    delete d->audio;
+
     delete d_ptr;
 }
 
@@ -210,7 +269,9 @@ void Emulator::reset()
     d->vdp->reset();
     d->cpu->reset();
     d->z80->reset();
+    d->scheduler->reset();
 
+    d->accumulator = 0;
     d->cycleTime.start();
 }
 
@@ -218,24 +279,24 @@ void Emulator::emulate()
 {
     Q_D(Emulator);
 
-    double currentTime = (double)d->cycleTime.nsecsElapsed() / 1000.0;
+    double currentTime = qMin((double)d->cycleTime.nsecsElapsed() / 1000.0, (double)MAX_CATCH_UP_US);
     d->cycleTime.start();
 
-    d->accumulator += 53.203424 * currentTime;
+    // Small differences between wall time and the audio device are absorbed by the audio rate control
+    d->accumulator += d->masterClockRate / 1000000.0 * currentTime;
 
     SDL_GameControllerUpdate();
     SDL_PumpEvents();
 
-    while(d->accumulator >= 420) {
-        d->cpu->clock(60); // 60
-        d->z80->clock(28); // 28
-        d->ym2612->clock(60);
-        d->vdp->clock(105);
+    qint64 cycles = static_cast<qint64>(d->accumulator);
+
+    if (cycles > 0) {
+        d->sliceCount += d->scheduler->run(cycles);
 
-        d->accumulator -= 420;
-        d->cyclesCount += 420;
-        d->ymCycles += 60;
-        d->z80Cycles += 28;
+        d->accumulator -= cycles;
+        d->cyclesCount += cycles;
+        d->ymCycles += cycles / 7;
+        d->z80Cycles += cycles / 15;
     }
 
     //53126640
@@ -253,11 +314,28 @@ void Emulator::emulate()
     //d->fpsCount++;
 }
 
+void Emulator::runFrame()
+{
+    Q_D(Emulator);
+
+    d->frameDone = false;
+
+    while (!d->frameDone) {
+        d->sliceCount += d->scheduler->run(LINE_CYCLES);
+        d->cyclesCount += LINE_CYCLES;
+    }
+}
+
 bool Emulator::loadCartridge(QString file)
 {
     Q_D(Emulator);
 
     d->cartridge->load(file);
+
+    // The cartridge replaced its ROM, refresh the direct memory pointers
+    d->z80Bus->remap();
+    d->bus->remap();
+
     this->reset();
 
     return true;
@@ -268,6 +346,29 @@ void Emulator::setClockRate(long clock)
     Q_D(Emulator);
 
     d->masterClockRate = clock;
+    d->ym2612->setClockRate(clock);
+}
+
+int Emulator::frameSkip() const
+{
+    Q_D(const Emulator);
+
+    return d->frameSkip;
+}
+
+void Emulator::setFrameSkip(int frames)
+{
+    Q_D(Emulator);
+
+    d->frameSkip = qMax(0, frames);
+    d->frameCounter = 0;
+}
+
+void Emulator::setVideoSink(VideoSink* sink)
+{
+    Q_D(Emulator);
+
+    d->vdp->setVideoSink(sink);
 }
 
 Motorola68000 *Emulator::mainCpu() const
@@ -290,16 +391,29 @@ void Emulator::reportFps() {
     qDebug() << "Master Clock:" << d->cyclesCount
              << "YM2612:" << d->ymCycles
              << "Z80:" << d->z80Cycles
+             << "Slices:" << d->sliceCount
              << "Fps:" << d->fpsCount;
+
+    if (d->audio)
+        qDebug() << "Audio:" << d->audio->fillLevel() << "/" << d->audio->capacity()
+                 << "Underruns:" << d->audio->takeUnderruns()
+                 << "Overruns:" << d->audio->takeOverruns();
+
     d->cyclesCount = 0;
+    d->sliceCount = 0;
     d->z80Cycles = 0;
     d->ymCycles = 0;
     d->fpsCount = 0;
 }
 
-void Emulator::updateFpsCount()
+void Emulator::startFrame()
 {
     Q_D(Emulator);
 
     d->fpsCount++;
+    d->frameDone = true;
+
+    // Only one out of every frameSkip + 1 frames is drawn
+    d->vdp->setRenderEnabled(d->frameCounter == 0);
+    d->frameCounter = (d->frameCounter + 1) % (d->frameSkip + 1);
 }
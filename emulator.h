@@ -6,22 +6,32 @@
 
 class VDP;
 class Motorola68000;
+class VideoSink;
 
 class EmulatorPrivate;
 class Emulator : public QObject
 {
     Q_OBJECT
 public:
-    explicit Emulator(SDL_Renderer* renderer, QObject *parent = nullptr);
+    explicit Emulator(QObject *parent = nullptr);
     ~Emulator();
 
     void reset();
     void emulate();
 
+    // Runs as fast as possible until the next frame starts
+    void runFrame();
+
     bool loadCartridge(QString file);
 
     void setClockRate(long clock);
 
+    // Number of frames emulated without drawing them after every drawn one
+    int  frameSkip() const;
+    void setFrameSkip(int frames);
+
+    void setVideoSink(VideoSink* sink);
+
     Motorola68000* mainCpu() const;
     VDP* vdp() const;
 
@@ -31,7 +41,7 @@ public slots:
     void reportFps();
 
 private slots:
-    void updateFpsCount();
+    void startFrame();
 
 private:
     EmulatorPrivate* d_ptr;
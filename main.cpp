@@ -1,6 +1,8 @@
 #include <QApplication>
 #include <QAbstractNativeEventFilter>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QScopedPointer>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,6 +10,8 @@
 #include <SDL2/SDL.h>
 
 #include "mainwindow.h"
+#include "emulator.h"
+#include "videosink.h"
 
 void debugOutput(QtMsgType type, const QMessageLogContext& context, const QString& msg) {
     Q_UNUSED(context);
@@ -49,9 +53,61 @@ public:
     }
 };
 
+/*
+ * Runs without a window or any SDL video, e.g.
+ *   derpdrive --headless rom.bin --frames 600 --raw-output frames.raw
+ * Frames go to a raw file (--raw-output), a shared memory segment (--shm key) or nowhere.
+ */
+int headless(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList arguments = a.arguments();
+
+    auto option = [&](const QString& name) {
+        int index = arguments.indexOf(name);
+        return index >= 0 && index + 1 < arguments.size() ? arguments.at(index + 1) : QString();
+    };
+
+    QString rom = option("--headless");
+    if (rom.isEmpty()) {
+        qDebug() << "Usage:" << arguments.first() << "--headless <rom> [--frames N] [--frame-skip N] [--raw-output file | --shm key]";
+        return 1;
+    }
+
+    int frames = option("--frames").isEmpty() ? 600 : option("--frames").toInt();
+
+    QScopedPointer<VideoSink> sink;
+    if (!option("--raw-output").isEmpty())
+        sink.reset(new RawFileVideoSink(option("--raw-output")));
+    else if (!option("--shm").isEmpty())
+        sink.reset(new SharedMemoryVideoSink(option("--shm")));
+
+    Emulator emulator;
+    emulator.setClockRate(53203424);
+    emulator.setVideoSink(sink.data());
+    emulator.setFrameSkip(option("--frame-skip").toInt());
+    emulator.loadCartridge(rom);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int frame = 0; frame < frames; frame++)
+        emulator.runFrame();
+
+    qint64 elapsed = qMax<qint64>(1, timer.elapsed());
+    qDebug() << "Emulated" << frames << "frames in" << elapsed << "ms," << (frames * 1000.0 / elapsed) << "fps";
+
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     // qInstallMessageHandler(debugOutput);
+    for (int i = 1; i < argc; i++) {
+        if (qstrcmp(argv[i], "--headless") == 0)
+            return headless(argc, argv);
+    }
+
     EventFilter sdlPipe;
 
     QApplication a(argc, argv);
@@ -4,6 +4,7 @@
 #include "m68kdebugger.h"
 
 #include "chips/vdp.h"
+#include "videosink.h"
 
 #include <QTimer>
 #include <QFileDialog>
@@ -26,11 +27,13 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->label->setUpdatesEnabled(false);
 
     this->renderWnd = SDL_CreateWindowFrom(reinterpret_cast<const void*>(ui->label->winId()));
-    this->renderer = SDL_CreateRenderer(this->renderWnd, -1, SDL_RENDERER_ACCELERATED);
+    this->vsync = qApp->arguments().contains("--vsync");
+    this->renderer = SDL_CreateRenderer(this->renderWnd, -1, SDL_RENDERER_ACCELERATED | (this->vsync ? SDL_RENDERER_PRESENTVSYNC : 0));
+    this->videoSink = new SDLVideoSink(this->renderer);
 
-
-    this->emulator = new Emulator(this->renderer, this);
+    this->emulator = new Emulator(this);
     this->emulator->setClockRate(53203424);
+    this->emulator->setVideoSink(this->videoSink);
 
     connect(this->emulator->vdp(),  &VDP::frameUpdated, this,                   &MainWindow::updateFrame);
     connect(ui->actionPlane_A,      &QAction::toggled,  this->emulator->vdp(),  &VDP::setPlaneA);
@@ -38,6 +41,13 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->actionWindow_Plane, &QAction::toggled,  this->emulator->vdp(),  &VDP::setWindowPlane);
     connect(ui->actionSprites,      &QAction::toggled,  this->emulator->vdp(),  &VDP::setSprites);
 
+    int frameSkip = qApp->arguments().indexOf("--frame-skip");
+    if (frameSkip >= 0 && frameSkip + 1 < qApp->arguments().size())
+        this->emulator->setFrameSkip(qApp->arguments().at(frameSkip + 1).toInt());
+
+    if (qApp->arguments().contains("--render-thread"))
+        this->emulator->vdp()->setRenderThread(true);
+
     if (qApp->arguments().contains("--debug") || qApp->arguments().contains("-d"))
         this->on_actionDebugger_M68K_triggered();
 
@@ -49,6 +59,9 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    this->emulator->setVideoSink(nullptr);
+    delete this->videoSink;
+
     SDL_DestroyRenderer(this->renderer);
     SDL_DestroyWindow(this->renderWnd);
 
@@ -57,17 +70,24 @@ MainWindow::~MainWindow()
 
 void MainWindow::emulateFrame()
 {
-    this->emulator->emulate();
+    // Presenting a frame blocks until the next refresh
+    if (this->vsync)
+        this->emulator->runFrame();
+    else
+        this->emulator->emulate();
 }
 
 void MainWindow::updateFrame(void* frame)
 {
     //SDL_UpdateTexture(this->currentFrame, nullptr, frame->constBits(), frame->bytesPerLine());
 
+    int width, height;
+    SDL_QueryTexture(reinterpret_cast<SDL_Texture*>(frame), nullptr, nullptr, &width, &height);
+
     SDL_Rect rect;
     rect.x = 0; rect.y = 0;
-    rect.w = ui->label->width();
-    rect.h = ui->label->height();
+    rect.w = qMin(ui->label->width(), width);
+    rect.h = qMin(ui->label->height(), height);
 
     SDL_SetRenderTarget(this->renderer, nullptr);
     SDL_SetRenderDrawColor(this->renderer, 0x00, 0x00, 0x00, 0xFF);
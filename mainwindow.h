@@ -11,6 +11,7 @@ class MainWindow;
 }
 
 class M68KDebugger;
+class SDLVideoSink;
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -19,6 +20,10 @@ private:
     Emulator*       emulator;
     SDL_Window*     renderWnd;
     SDL_Renderer*   renderer;
+    SDLVideoSink*   videoSink;
+
+    // Run a frame per display refresh instead of following the wall clock
+    bool            vsync;
 
 public:
     explicit MainWindow(QWidget *parent = 0);
@@ -58,6 +58,34 @@ int MemoryBank::poke(quint32 address, quint8 val)
     return d->mem->poke(d->baseAddress + address, val);
 }
 
+int MemoryBank::peek16(quint32 address, quint16 &val)
+{
+    Q_D(MemoryBank);
+
+    return d->mem->peek16(d->baseAddress + address, val);
+}
+
+int MemoryBank::peek32(quint32 address, quint32 &val)
+{
+    Q_D(MemoryBank);
+
+    return d->mem->peek32(d->baseAddress + address, val);
+}
+
+int MemoryBank::poke16(quint32 address, quint16 val)
+{
+    Q_D(MemoryBank);
+
+    return d->mem->poke16(d->baseAddress + address, val);
+}
+
+int MemoryBank::poke32(quint32 address, quint32 val)
+{
+    Q_D(MemoryBank);
+
+    return d->mem->poke32(d->baseAddress + address, val);
+}
+
 void MemoryBank::pushBankBit(quint8 bit)
 {
     Q_D(MemoryBank);
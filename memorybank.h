@@ -20,6 +20,10 @@ public:
 
     int     peek(quint32 address, quint8& val);
     int     poke(quint32 address, quint8 val);
+    int     peek16(quint32 address, quint16& val);
+    int     peek32(quint32 address, quint32& val);
+    int     poke16(quint32 address, quint16 val);
+    int     poke32(quint32 address, quint32 val);
 
     void    pushBankBit(quint8 bit);
 
@@ -5,6 +5,8 @@
 
 #include <config.h>
 
+// A page wired to a single device only stores the device and how to translate
+// the address, pages with mixed wiring (I/O areas) fall back to a byte table.
 struct MemoryWiring {
    public:
       qint32   address;
@@ -18,24 +20,116 @@ struct MemoryWiring {
       }
 };
 
+struct MemoryPage {
+   public:
+      IMemory*       device;  // Device wired to the whole page
+      quint32        base;    // Device address = base + (bus address & mask)
+      quint32        mask;
+      qint32         handle;
+      MemoryWiring*  wiring;  // Byte granular wiring, if the page is split
+
+   public:
+      MemoryPage()
+         : device(nullptr),
+           base(0),
+           mask(MEMORY_PAGE_MASK),
+           handle(-1),
+           wiring(nullptr)
+      {
+      }
+};
+
 class MemoryBusPrivate {
    public:
-      int                  busSize;
-      MemoryWiring*        wiring; //[BUS_SIZE];
+      quint32              busSize;
+      int                  pageCount;
+      MemoryPage*          pages;
+      MemoryHostPage*      hostPages;
       QVector<IMemory*>    devices;
       quint32              exceptionAddress;
 
    public:
       MemoryBusPrivate(MemoryBus* q)
          : q_ptr(q),
-           wiring(0)
+           pageCount(0),
+           pages(0),
+           hostPages(0)
       {
-         qDebug() << "BUS Size:" << (sizeof(this->wiring) / sizeof(MemoryWiring));
       }
 
       ~MemoryBusPrivate() {
-         if (this->wiring)
-            delete[] this->wiring;
+         for (int i=0; i < this->pageCount; i++)
+            delete[] this->pages[i].wiring;
+
+         delete[] this->pages;
+         delete[] this->hostPages;
+      }
+
+      void mapHostPage(int index) {
+         const MemoryPage& page = this->pages[index];
+         MemoryHostPage& host = this->hostPages[index];
+
+         host.mask = page.mask;
+
+         if (page.device) {
+            host.read  = page.device->hostMemory(page.base, page.mask + 1, false);
+            host.write = page.device->hostMemory(page.base, page.mask + 1, true);
+         } else {
+            host.read  = nullptr;
+            host.write = nullptr;
+         }
+      }
+
+      void wirePage(MemoryPage& page, qint32 handle, quint32 base, quint32 mask) {
+         delete[] page.wiring;
+
+         page.wiring = nullptr;
+         page.handle = handle;
+         page.device = handle >= 0 ? this->devices.at(handle) : nullptr;
+         page.base   = base;
+         page.mask   = mask;
+      }
+
+      void splitPage(MemoryPage& page) {
+         if (page.wiring)
+            return;
+
+         // Expand the current page mapping into a byte granular table
+         page.wiring = new MemoryWiring[MEMORY_PAGE_SIZE];
+
+         for (int i=0; i < MEMORY_PAGE_SIZE; i++) {
+            page.wiring[i].address = page.base + (i & page.mask);
+            page.wiring[i].handle  = page.handle;
+         }
+
+         page.device = nullptr;
+         page.handle = -1;
+      }
+
+      // Returns the device both bytes of a word at address are wired to, if they
+      // are wired to consecutive addresses of the same device
+      IMemory* wordDevice(quint32 address, quint32& deviceAddress) const {
+         const MemoryPage& page = this->pages[address >> MEMORY_PAGE_SHIFT];
+
+         if (page.device) {
+            if ((address & page.mask) >= page.mask)
+               return nullptr;
+
+            deviceAddress = page.base + (address & page.mask);
+            return page.device;
+         }
+
+         if (!page.wiring || (address & MEMORY_PAGE_MASK) >= MEMORY_PAGE_MASK)
+            return nullptr;
+
+         const MemoryWiring& w0 = page.wiring[address & MEMORY_PAGE_MASK];
+         const MemoryWiring& w1 = page.wiring[(address & MEMORY_PAGE_MASK) + 1];
+
+         if (w0.handle < 0 || w0.handle != w1.handle || w1.address != w0.address + 1)
+            return nullptr;
+
+         deviceAddress = w0.address;
+         return this->devices.at(w0.handle);
       }
 
    private:
@@ -50,8 +144,15 @@ MemoryBus::MemoryBus(int size, QObject *parent)
 {
    Q_D(MemoryBus);
 
-   d->busSize = size;
-   d->wiring = new MemoryWiring[size];
+   d->busSize = static_cast<quint32>(size);
+   d->pageCount = (size + MEMORY_PAGE_MASK) >> MEMORY_PAGE_SHIFT;
+   d->pages = new MemoryPage[d->pageCount];
+   d->hostPages = new MemoryHostPage[d->pageCount];
+
+   for (int i=0; i < d->pageCount; i++)
+      d->mapHostPage(i);
+
+   qDebug() << "BUS Size:" << size << "Pages:" << d->pageCount;
 }
 
 MemoryBus::~MemoryBus()
@@ -68,19 +169,50 @@ qint32 MemoryBus::attachDevice(IMemory* dev)
    return d->devices.length()-1;
 }
 
-void MemoryBus::wire(int start, int end, int base, qint32 device)
+void MemoryBus::wire(int start, int end, int base, qint32 device, int mirrorMask)
 {
    Q_D(MemoryBus);
 
-   if (start >= d->busSize || end > d->busSize) {
+   if (static_cast<quint32>(start) >= d->busSize || static_cast<quint32>(end) > d->busSize) {
       qCritical() << "Can't wire address past bus size:" <<  start;
       return;
    }
 
-   // Divide by two to align with word boundary
-   for(int i=start; i <= end; i++) {
-      d->wiring[i].address = base++;
-      d->wiring[i].handle  = device;
+   // Device address for a bus address is base + ((address - start) & mirrorMask)
+   int address = start;
+   while (address <= end) {
+      int index = address >> MEMORY_PAGE_SHIFT;
+      MemoryPage& page = d->pages[index];
+
+      int pageStart = address & ~MEMORY_PAGE_MASK;
+      int pageEnd   = pageStart + MEMORY_PAGE_MASK;
+      quint32 offset = (pageStart - start) & mirrorMask;
+
+      if (address == pageStart && pageEnd <= end) {
+         // The range covers the whole page, try to describe it without a byte table
+         if (mirrorMask == -1 ||
+             ((mirrorMask & MEMORY_PAGE_MASK) == MEMORY_PAGE_MASK && !(offset & MEMORY_PAGE_MASK))) {
+            d->wirePage(page, device, base + offset, MEMORY_PAGE_MASK);
+            d->mapHostPage(index);
+            address = pageEnd + 1;
+            continue;
+         }
+
+         if (mirrorMask < MEMORY_PAGE_MASK && !(mirrorMask & (mirrorMask + 1)) && !offset) {
+            d->wirePage(page, device, base, mirrorMask);
+            d->mapHostPage(index);
+            address = pageEnd + 1;
+            continue;
+         }
+      }
+
+      d->splitPage(page);
+      d->mapHostPage(index);
+
+      for (; address <= end && address <= pageEnd; address++) {
+         page.wiring[address & MEMORY_PAGE_MASK].address = base + ((address - start) & mirrorMask);
+         page.wiring[address & MEMORY_PAGE_MASK].handle  = device;
+      }
    }
 }
 
@@ -88,13 +220,12 @@ void MemoryBus::wire(int src, int dst, qint32 device)
 {
    Q_D(MemoryBus);
 
-   if (src >= d->busSize) {
+   if (static_cast<quint32>(src) >= d->busSize) {
       qCritical() << "Can't wire address past bus size:" <<  src;
       return;
    }
 
-   d->wiring[src].address = dst;
-   d->wiring[src].handle  = device;
+   this->wire(src, src, dst, device);
 }
 
 int MemoryBus::peek(quint32 address, quint8& val) {
@@ -107,15 +238,21 @@ int MemoryBus::peek(quint32 address, quint8& val) {
       return BUS_ERROR;
    }
 
+   const MemoryPage& page = d->pages[address >> MEMORY_PAGE_SHIFT];
+
    // Check if adress is hooked up
-   if(Q_LIKELY(d->wiring[address].handle >= 0)) {
-      IMemory* dev = d->devices[d->wiring[address].handle];
-      return dev->peek(d->wiring[address].address, val);
-   } else {
-      d->exceptionAddress = address;
-      val = 0;
-      return BUS_ERROR;
+   if (Q_LIKELY(page.device)) {
+      return page.device->peek(page.base + (address & page.mask), val);
+   } else if (page.wiring) {
+      const MemoryWiring& wiring = page.wiring[address & MEMORY_PAGE_MASK];
+
+      if (wiring.handle >= 0)
+         return d->devices.at(wiring.handle)->peek(wiring.address, val);
    }
+
+   d->exceptionAddress = address;
+   val = 0;
+   return BUS_ERROR;
 }
 
 int MemoryBus::poke(quint32 address, quint8 val) {
@@ -127,15 +264,120 @@ int MemoryBus::poke(quint32 address, quint8 val) {
       return BUS_ERROR;
    }
 
-   if(d->wiring[address].handle >= 0) {
-      IMemory* dev = d->devices[d->wiring[address].handle];
-      return dev->poke(d->wiring[address].address, val);
+   const MemoryPage& page = d->pages[address >> MEMORY_PAGE_SHIFT];
+
+   if (page.device) {
+      return page.device->poke(page.base + (address & page.mask), val);
+   } else if (page.wiring) {
+      const MemoryWiring& wiring = page.wiring[address & MEMORY_PAGE_MASK];
+
+      if (wiring.handle >= 0)
+         return d->devices.at(wiring.handle)->poke(wiring.address, val);
    }
 
    d->exceptionAddress = address;
    return BUS_ERROR;
 }
 
+int MemoryBus::peek16(quint32 address, quint16& val)
+{
+   Q_D(MemoryBus);
+
+   if (Q_UNLIKELY(address + 1 >= d->busSize))
+      return IMemory::peek16(address, val);
+
+   const MemoryHostPage& host = d->hostPages[address >> MEMORY_PAGE_SHIFT];
+   if (host.read && (address & host.mask) < host.mask) {
+      const quint8* data = host.read + (address & host.mask);
+      val = static_cast<quint16>((data[0] << 8) | data[1]);
+      return NO_ERROR;
+   }
+
+   quint32 deviceAddress;
+   IMemory* dev = d->wordDevice(address, deviceAddress);
+
+   if (dev)
+      return dev->peek16(deviceAddress, val);
+
+   return IMemory::peek16(address, val);
+}
+
+int MemoryBus::peek32(quint32 address, quint32& val)
+{
+   Q_D(MemoryBus);
+
+   if (Q_UNLIKELY(address + 3 >= d->busSize))
+      return IMemory::peek32(address, val);
+
+   const MemoryPage& page = d->pages[address >> MEMORY_PAGE_SHIFT];
+   if (page.device && (address & page.mask) + 3 <= page.mask)
+      return page.device->peek32(page.base + (address & page.mask), val);
+
+   return IMemory::peek32(address, val);
+}
+
+int MemoryBus::poke16(quint32 address, quint16 val)
+{
+   Q_D(MemoryBus);
+
+   if (Q_UNLIKELY(address + 1 >= d->busSize))
+      return IMemory::poke16(address, val);
+
+   quint32 deviceAddress;
+   IMemory* dev = d->wordDevice(address, deviceAddress);
+
+   if (dev)
+      return dev->poke16(deviceAddress, val);
+
+   return IMemory::poke16(address, val);
+}
+
+int MemoryBus::poke32(quint32 address, quint32 val)
+{
+   Q_D(MemoryBus);
+
+   if (Q_UNLIKELY(address + 3 >= d->busSize))
+      return IMemory::poke32(address, val);
+
+   const MemoryPage& page = d->pages[address >> MEMORY_PAGE_SHIFT];
+   if (page.device && (address & page.mask) + 3 <= page.mask)
+      return page.device->poke32(page.base + (address & page.mask), val);
+
+   return IMemory::poke32(address, val);
+}
+
+quint8* MemoryBus::hostMemory(quint32 address, quint32 length, bool write)
+{
+   Q_D(MemoryBus);
+
+   if (address >= d->busSize)
+      return nullptr;
+
+   const MemoryHostPage& host = d->hostPages[address >> MEMORY_PAGE_SHIFT];
+   quint8* memory = write ? host.write : host.read;
+
+   // The requested range has to stay inside the page (or its mirror window)
+   if (!memory || (address & host.mask) + length > host.mask + 1)
+      return nullptr;
+
+   return memory + (address & host.mask);
+}
+
+const MemoryHostPage* MemoryBus::hostPages() const
+{
+   Q_D(const MemoryBus);
+
+   return d->hostPages;
+}
+
+void MemoryBus::remap()
+{
+   Q_D(MemoryBus);
+
+   for (int i=0; i < d->pageCount; i++)
+      d->mapHostPage(i);
+}
+
 quint32 MemoryBus::lastExceptionAddress()
 {
    return 0;
@@ -3,6 +3,11 @@
 
 #include <QObject>
 
+// The bus is decoded in pages of MEMORY_PAGE_SIZE bytes
+#define MEMORY_PAGE_SHIFT  11
+#define MEMORY_PAGE_SIZE   (1 << MEMORY_PAGE_SHIFT)
+#define MEMORY_PAGE_MASK   (MEMORY_PAGE_SIZE - 1)
+
 struct IMemory {
    public:
       enum Error {
@@ -13,6 +18,59 @@ struct IMemory {
    public:
       virtual int peek(quint32 address, quint8& val) = 0;
       virtual int poke(quint32 address, quint8 val) = 0;
+
+      // Big endian word and long access. The defaults split the access into
+      // bytes, devices override them to handle the access in one dispatch.
+      virtual int peek16(quint32 address, quint16& val) {
+         quint8 b0 = 0, b1 = 0;
+
+         int r0 = this->peek(address,     b0);
+         int r1 = this->peek(address + 1, b1);
+
+         val = static_cast<quint16>((b0 << 8) | b1);
+         return r0 != NO_ERROR ? r0 : r1;
+      }
+
+      virtual int peek32(quint32 address, quint32& val) {
+         quint16 w0 = 0, w1 = 0;
+
+         int r0 = this->peek16(address,     w0);
+         int r1 = this->peek16(address + 2, w1);
+
+         val = (static_cast<quint32>(w0) << 16) | w1;
+         return r0 != NO_ERROR ? r0 : r1;
+      }
+
+      virtual int poke16(quint32 address, quint16 val) {
+         int r0 = this->poke(address,     static_cast<quint8>(val >> 8));
+         int r1 = this->poke(address + 1, static_cast<quint8>(val & 0xFF));
+
+         return r0 != NO_ERROR ? r0 : r1;
+      }
+
+      virtual int poke32(quint32 address, quint32 val) {
+         int r0 = this->poke16(address,     static_cast<quint16>(val >> 16));
+         int r1 = this->poke16(address + 2, static_cast<quint16>(val & 0xFFFF));
+
+         return r0 != NO_ERROR ? r0 : r1;
+      }
+
+      // Returns the host memory backing [address, address + length) if the
+      // device is plain memory there, so the bus can skip peek()/poke().
+      virtual quint8* hostMemory(quint32 address, quint32 length, bool write) {
+         Q_UNUSED(address);
+         Q_UNUSED(length);
+         Q_UNUSED(write);
+         return nullptr;
+      }
+};
+
+// Host pointers of a bus page, indexed with (address & mask).
+// Null if the page needs to be dispatched to its device.
+struct MemoryHostPage {
+   quint8*  read;
+   quint8*  write;
+   quint32  mask;
 };
 
 class MemoryBusPrivate;
@@ -28,11 +86,19 @@ class MemoryBus :
       qint32   attachDevice(IMemory* dev);
       void     detachDevice(IMemory* dev);
 
-      void     wire(int start, int end, int base, qint32 device);
+      void     wire(int start, int end, int base, qint32 device, int mirrorMask = -1);
       void     wire(int src, int dst, qint32 device);
 
       int      peek(quint32 address, quint8& val);
       int      poke(quint32 address, quint8 val);
+      int      peek16(quint32 address, quint16& val);
+      int      peek32(quint32 address, quint32& val);
+      int      poke16(quint32 address, quint16 val);
+      int      poke32(quint32 address, quint32 val);
+      quint8*  hostMemory(quint32 address, quint32 length, bool write);
+
+      const MemoryHostPage* hostPages() const;
+      void     remap();
 
       quint32  lastExceptionAddress();
 
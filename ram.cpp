@@ -44,3 +44,66 @@ int Ram::poke(quint32 address, quint8 val)
     d->data[address] = val;
     return NO_ERROR;
 }
+
+int Ram::peek16(quint32 address, quint16& val)
+{
+    Q_D(Ram);
+
+    if (address + 2 > static_cast<quint32>(d->data.size()))
+        return IMemory::peek16(address, val);
+
+    const quint8* data = reinterpret_cast<const quint8*>(d->data.constData()) + address;
+    val = static_cast<quint16>((data[0] << 8) | data[1]);
+    return NO_ERROR;
+}
+
+int Ram::peek32(quint32 address, quint32& val)
+{
+    Q_D(Ram);
+
+    if (address + 4 > static_cast<quint32>(d->data.size()))
+        return IMemory::peek32(address, val);
+
+    const quint8* data = reinterpret_cast<const quint8*>(d->data.constData()) + address;
+    val = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+    return NO_ERROR;
+}
+
+int Ram::poke16(quint32 address, quint16 val)
+{
+    Q_D(Ram);
+
+    if (address + 2 > static_cast<quint32>(d->data.size()))
+        return IMemory::poke16(address, val);
+
+    quint8* data = reinterpret_cast<quint8*>(d->data.data()) + address;
+    data[0] = static_cast<quint8>(val >> 8);
+    data[1] = static_cast<quint8>(val & 0xFF);
+    return NO_ERROR;
+}
+
+int Ram::poke32(quint32 address, quint32 val)
+{
+    Q_D(Ram);
+
+    if (address + 4 > static_cast<quint32>(d->data.size()))
+        return IMemory::poke32(address, val);
+
+    quint8* data = reinterpret_cast<quint8*>(d->data.data()) + address;
+    data[0] = static_cast<quint8>(val >> 24);
+    data[1] = static_cast<quint8>(val >> 16);
+    data[2] = static_cast<quint8>(val >> 8);
+    data[3] = static_cast<quint8>(val & 0xFF);
+    return NO_ERROR;
+}
+
+quint8* Ram::hostMemory(quint32 address, quint32 length, bool write)
+{
+    Q_D(Ram);
+    Q_UNUSED(write);
+
+    if (address + length > static_cast<quint32>(d->data.size()))
+        return nullptr;
+
+    return reinterpret_cast<quint8*>(d->data.data()) + address;
+}
@@ -17,6 +17,11 @@ class Ram
 
       int      peek(quint32 address, quint8& val);
       int      poke(quint32 address, quint8 val);
+      int      peek16(quint32 address, quint16& val);
+      int      peek32(quint32 address, quint32& val);
+      int      poke16(quint32 address, quint16 val);
+      int      poke32(quint32 address, quint32 val);
+      quint8*  hostMemory(quint32 address, quint32 length, bool write);
 
    signals:
 
@@ -0,0 +1,140 @@
+#include "resampler.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESAMPLER_SSE2
+#include <emmintrin.h>
+#endif
+
+#define RESAMPLER_ONE       (Q_UINT64_C(1) << 32)
+
+Resampler::Resampler()
+    : historyPos(0),
+      position(0),
+      step(RESAMPLER_ONE),
+      baseStep(RESAMPLER_ONE)
+{
+    this->reset();
+    this->setRates(1, 1);
+}
+
+void Resampler::setRates(double inputRate, double outputRate)
+{
+    // A device that failed to open reports a rate of 0, keep the current filter
+    if (inputRate <= 0 || outputRate <= 0)
+        return;
+
+    double ratio = inputRate / outputRate;
+
+    // Keep some headroom below both Nyquist rates for the transition band
+    this->buildFilter(0.45 * qMin(1.0, 1.0 / ratio));
+    this->baseStep = static_cast<quint64>(ratio * RESAMPLER_ONE);
+    this->step = this->baseStep;
+}
+
+double Resampler::ratio() const
+{
+    return static_cast<double>(this->step) / RESAMPLER_ONE;
+}
+
+void Resampler::setAdjustment(double factor)
+{
+    this->step = static_cast<quint64>(this->baseStep * factor);
+}
+
+void Resampler::reset()
+{
+    memset(this->history, 0, sizeof(this->history));
+
+    this->historyPos = 0;
+    this->position = 0;
+}
+
+int Resampler::maxOutput(int frames) const
+{
+    return static_cast<int>((static_cast<quint64>(frames) * RESAMPLER_ONE) / this->step) + 1;
+}
+
+void Resampler::buildFilter(double cutoff)
+{
+    const double pi = 3.14159265358979323846;
+
+    for (int phase = 0; phase < RESAMPLER_PHASES; phase++) {
+        double fraction = static_cast<double>(phase) / RESAMPLER_PHASES;
+        double taps[RESAMPLER_TAPS];
+        double sum = 0;
+
+        for (int i = 0; i < RESAMPLER_TAPS; i++) {
+            // Distance of the tap to the output position, centered in the filter
+            double x = i - RESAMPLER_TAPS / 2 + 1 - fraction;
+            double sinc = x == 0 ? 1.0 : sin(2 * pi * cutoff * x) / (2 * pi * cutoff * x);
+            double window = 0.42 + 0.5 * cos(2 * pi * x / RESAMPLER_TAPS) + 0.08 * cos(4 * pi * x / RESAMPLER_TAPS);
+
+            taps[i] = sinc * window;
+            sum += taps[i];
+        }
+
+        // Unity gain for every phase
+        for (int i = 0; i < RESAMPLER_TAPS; i++)
+            this->coefficients[phase][i] = static_cast<qint16>(lrint(taps[i] / sum * 0x7FFF));
+    }
+}
+
+void Resampler::filter(int phase, qint16* output) const
+{
+    const qint16* coefficients = this->coefficients[phase];
+
+    for (int c = 0; c < 2; c++) {
+        const qint16* samples = this->history[c] + this->historyPos;
+
+#ifdef RESAMPLER_SSE2
+        __m128i sum = _mm_setzero_si128();
+
+        for (int i = 0; i < RESAMPLER_TAPS; i += 8) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+            __m128i h = _mm_load_si128(reinterpret_cast<const __m128i*>(coefficients + i));
+
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(x, h));
+        }
+
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+        int result = _mm_cvtsi128_si32(sum);
+#else
+        int result = 0;
+
+        for (int i = 0; i < RESAMPLER_TAPS; i++)
+            result += samples[i] * coefficients[i];
+#endif
+
+        output[c] = static_cast<qint16>(qBound(-0x8000, (result + 0x4000) >> 15, 0x7FFF));
+    }
+}
+
+int Resampler::process(const qint16* input, int frames, qint16* output)
+{
+    int written = 0;
+
+    for (int i = 0; i < frames; i++) {
+        // The newest frame ends up at the last tap
+        for (int c = 0; c < 2; c++) {
+            this->history[c][this->historyPos] = input[i * 2 + c];
+            this->history[c][this->historyPos + RESAMPLER_TAPS] = input[i * 2 + c];
+        }
+
+        this->historyPos = (this->historyPos + 1) % RESAMPLER_TAPS;
+
+        while (this->position < RESAMPLER_ONE) {
+            this->filter(static_cast<int>(this->position >> 24), output + written * 2);
+            this->position += this->step;
+            written++;
+        }
+
+        this->position -= RESAMPLER_ONE;
+    }
+
+    return written;
+}
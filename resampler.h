@@ -0,0 +1,53 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <QtGlobal>
+
+#define RESAMPLER_TAPS      32
+#define RESAMPLER_PHASES    256
+
+/*
+ * Band-limited polyphase resampler for interleaved 16 bit stereo.
+ *
+ * Each output frame is a windowed sinc FIR over the last RESAMPLER_TAPS input frames,
+ * using the filter phase closest to the fractional output position. The cutoff sits
+ * below the lower of both Nyquist rates, so downsampling does not alias.
+ */
+class Resampler
+{
+public:
+    Resampler();
+
+    void    setRates(double inputRate, double outputRate);
+    double  ratio() const;
+
+    // Scales the ratio set with setRates() without rebuilding the filter
+    void    setAdjustment(double factor);
+
+    void    reset();
+
+    // Output frames the given amount of input frames produce at most
+    int     maxOutput(int frames) const;
+
+    // Returns the amount of frames written to output
+    int     process(const qint16* input, int frames, qint16* output);
+
+private:
+    void    buildFilter(double cutoff);
+    void    filter(int phase, qint16* output) const;
+
+private:
+    // Filter phases, the taps run from the oldest to the newest input frame
+    alignas(16) qint16  coefficients[RESAMPLER_PHASES][RESAMPLER_TAPS];
+
+    // Separate channels, every frame is stored twice so the taps are always contiguous
+    alignas(16) qint16  history[2][RESAMPLER_TAPS * 2];
+    int         historyPos;
+
+    // Position of the next output frame after the newest input frame, 32.32 fixed point
+    quint64     position;
+    quint64     step;
+    quint64     baseStep;
+};
+
+#endif // RESAMPLER_H
@@ -0,0 +1,191 @@
+#include "scheduler.h"
+
+#include <chips/motorola68000.h>
+#include <chips/z80.h>
+#include <chips/vdp.h>
+#include <chips/ym2612.h>
+#include <audiothread.h>
+
+// Longest slice, one native YM2612 sample. The Z80 only runs once the 68k has finished
+// a slice, this keeps both and their sound chip writes interleaved at audio resolution.
+#define SCHEDULER_MAX_SLICE (YM2612_DIVIDER * 144)
+
+class SchedulerPrivate {
+public:
+    Motorola68000*  cpu;
+    Z80*            z80;
+    VDP*            vdp;
+    YM2612*         ym2612;
+    AudioThread*    audioThread;
+
+    // Master cycle each device has been run up to
+    qint64          masterCycle;
+    qint64          cpuCycle;
+    qint64          z80Cycle;
+    qint64          audioCycle;
+
+    // Master cycles run before the last reset
+    qint64          epoch;
+    qint64          vdpCycle;
+
+    bool            cpuRunning;
+    bool            z80Running;
+
+public:
+    SchedulerPrivate(Scheduler* q)
+        : q_ptr(q),
+          cpu(nullptr),
+          z80(nullptr),
+          vdp(nullptr),
+          ym2612(nullptr),
+          audioThread(nullptr),
+          masterCycle(0),
+          cpuCycle(0),
+          z80Cycle(0),
+          audioCycle(0),
+          epoch(0),
+          vdpCycle(0),
+          cpuRunning(false),
+          z80Running(false)
+    {
+
+    }
+
+    // Runs a device with the given divider from its current cycle up to target
+    template<typename T>
+    inline void catchUp(T* device, qint64& cycle, qint64 target, int divider) {
+        int ticks = static_cast<int>((target - cycle) / divider);
+
+        if (ticks > 0) {
+            device->clock(ticks);
+            cycle += static_cast<qint64>(ticks) * divider;
+        }
+    }
+
+public:
+    Scheduler* q_ptr;
+    Q_DECLARE_PUBLIC(Scheduler)
+};
+
+Scheduler::Scheduler(QObject *parent)
+    : QObject(parent),
+      d_ptr(new SchedulerPrivate(this))
+{
+
+}
+
+Scheduler::~Scheduler()
+{
+    delete d_ptr;
+}
+
+void Scheduler::attachCpu(Motorola68000* cpu)
+{
+    Q_D(Scheduler);
+
+    d->cpu = cpu;
+}
+
+void Scheduler::attachZ80(Z80* z80)
+{
+    Q_D(Scheduler);
+
+    d->z80 = z80;
+}
+
+void Scheduler::attachVdp(VDP* vdp)
+{
+    Q_D(Scheduler);
+
+    d->vdp = vdp;
+}
+
+void Scheduler::attachYm2612(YM2612* ym2612)
+{
+    Q_D(Scheduler);
+
+    d->ym2612 = ym2612;
+}
+
+void Scheduler::attachAudioThread(AudioThread* audioThread)
+{
+    Q_D(Scheduler);
+
+    d->audioThread = audioThread;
+}
+
+void Scheduler::reset()
+{
+    Q_D(Scheduler);
+
+    d->epoch += d->masterCycle;
+    d->masterCycle = 0;
+    d->cpuCycle = 0;
+    d->z80Cycle = 0;
+    d->audioCycle = 0;
+    d->vdpCycle = 0;
+}
+
+int Scheduler::run(qint64 cycles)
+{
+    Q_D(Scheduler);
+
+    qint64 target = d->masterCycle + cycles;
+    int slices = 0;
+
+    while (d->masterCycle < target) {
+        // Stop at the next point the VDP may raise an interrupt
+        qint64 next = qMin(target, d->masterCycle + SCHEDULER_MAX_SLICE);
+        next = qMin(next, d->vdpCycle + static_cast<qint64>(d->vdp->nextEvent()) * VDP_DIVIDER);
+
+        // and at the next timer overflow, so the Z80 polling the flags sees it in its slice
+        qint64 overflow = d->ym2612->nextOverflow();
+
+        if (overflow >= 0)
+            next = qMin(next, overflow - d->epoch);
+
+        // The 68k finishes its last instruction, the overshoot is paid in the next slice
+        if (d->cpuCycle < next) {
+            int ticks = static_cast<int>((next - d->cpuCycle + M68K_DIVIDER - 1) / M68K_DIVIDER);
+
+            d->cpuRunning = true;
+            d->cpuCycle += static_cast<qint64>(d->cpu->clock(ticks)) * M68K_DIVIDER;
+            d->cpuRunning = false;
+        }
+
+        d->z80Running = true;
+        d->catchUp(d->z80, d->z80Cycle, next, Z80_DIVIDER);
+        d->z80Running = false;
+
+        d->catchUp(d->vdp, d->vdpCycle, next, VDP_DIVIDER);
+
+        // Every write of the slice is logged, the audio thread may render up to its end
+        if (d->audioThread)
+            d->catchUp(d->audioThread, d->audioCycle, next, 1);
+
+        d->masterCycle = next;
+        slices++;
+    }
+
+    return slices;
+}
+
+qint64 Scheduler::now() const
+{
+    Q_D(const Scheduler);
+
+    if (d->cpuRunning)
+        return d->cpuCycle + static_cast<qint64>(d->cpu->cyclesRun()) * M68K_DIVIDER;
+
+    if (d->z80Running)
+        return d->z80Cycle + static_cast<qint64>(d->z80->cyclesRun()) * Z80_DIVIDER;
+
+    return d->masterCycle;
+}
+
+qint64 Scheduler::timestamp() const
+{
+    Q_D(const Scheduler);
+
+    return d->epoch + this->now();
+}
@@ -0,0 +1,49 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <QObject>
+
+// Master clock dividers
+#define M68K_DIVIDER    7
+#define Z80_DIVIDER     15
+#define YM2612_DIVIDER  7
+#define VDP_DIVIDER     4
+
+class Motorola68000;
+class Z80;
+class VDP;
+class YM2612;
+class AudioThread;
+
+class SchedulerPrivate;
+class Scheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Scheduler(QObject *parent = nullptr);
+    ~Scheduler();
+
+    void attachCpu(Motorola68000* cpu);
+    void attachZ80(Z80* z80);
+    void attachVdp(VDP* vdp);
+    void attachYm2612(YM2612* ym2612);
+    void attachAudioThread(AudioThread* audioThread);
+
+    void reset();
+
+    // Runs every device for the given amount of master clock cycles,
+    // returns the number of slices it took
+    int run(qint64 cycles);
+
+    // Current master cycle, includes the progress of a running 68k or Z80 slice
+    qint64 now() const;
+
+    // Master cycles since construction, unlike now() it keeps counting across reset()
+    qint64 timestamp() const;
+
+private:
+    SchedulerPrivate* d_ptr;
+    Q_DECLARE_PRIVATE(Scheduler)
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,159 @@
+#include "videosink.h"
+
+#include <chips/vdprenderer.h>
+
+#include <QDebug>
+
+#define FRAME_SIZE (sizeof(quint32) * FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT)
+
+// ======== Null ========
+
+NullVideoSink::NullVideoSink()
+{
+    this->buffer = static_cast<quint32*>(malloc(FRAME_SIZE));
+    memset(this->buffer, 0, FRAME_SIZE);
+}
+
+NullVideoSink::~NullVideoSink()
+{
+    free(this->buffer);
+}
+
+quint32* NullVideoSink::lockFrame(int* pitch)
+{
+    *pitch = FRAMEBUFFER_WIDTH;
+
+    return this->buffer;
+}
+
+void NullVideoSink::unlockFrame()
+{
+
+}
+
+void* NullVideoSink::frame() const
+{
+    return this->buffer;
+}
+
+// ======== SDL ========
+
+SDLVideoSink::SDLVideoSink(SDL_Renderer* renderer)
+{
+    this->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+    SDL_SetTextureBlendMode(this->texture, SDL_BLENDMODE_BLEND);
+}
+
+SDLVideoSink::~SDLVideoSink()
+{
+    SDL_DestroyTexture(this->texture);
+}
+
+quint32* SDLVideoSink::lockFrame(int* pitch)
+{
+    void* pixels;
+
+    SDL_LockTexture(this->texture, nullptr, &pixels, pitch);
+    *pitch /= sizeof(quint32);
+
+    return static_cast<quint32*>(pixels);
+}
+
+void SDLVideoSink::unlockFrame()
+{
+    SDL_UnlockTexture(this->texture);
+}
+
+void* SDLVideoSink::frame() const
+{
+    return this->texture;
+}
+
+// ======== Raw file ========
+
+RawFileVideoSink::RawFileVideoSink(const QString& fileName)
+    : file(fileName)
+{
+    if (!this->file.open(QFile::WriteOnly | QFile::Truncate))
+        qDebug() << "Failed to open" << fileName;
+}
+
+void RawFileVideoSink::unlockFrame()
+{
+    if (this->file.isOpen())
+        this->file.write(reinterpret_cast<const char*>(this->buffer), FRAME_SIZE);
+}
+
+// ======== Shared memory ========
+
+SharedMemoryVideoSink::SharedMemoryVideoSink(const QString& key)
+    : memory(key),
+      fallback(nullptr)
+{
+    int size = sizeof(SharedFrameHeader) + 2 * FRAME_SIZE;
+
+    if (!this->memory.create(size) && !(this->memory.error() == QSharedMemory::AlreadyExists && this->memory.attach())) {
+        qDebug() << "Failed to create shared memory" << key << this->memory.errorString();
+
+        this->fallback = static_cast<quint32*>(malloc(FRAME_SIZE));
+        return;
+    }
+
+    this->memory.lock();
+
+    SharedFrameHeader* header = this->header();
+    memset(header, 0, sizeof(SharedFrameHeader));
+    header->width = FRAMEBUFFER_WIDTH;
+    header->height = FRAMEBUFFER_HEIGHT;
+    header->pitch = FRAMEBUFFER_WIDTH;
+
+    this->memory.unlock();
+}
+
+SharedMemoryVideoSink::~SharedMemoryVideoSink()
+{
+    free(this->fallback);
+}
+
+SharedFrameHeader* SharedMemoryVideoSink::header() const
+{
+    return static_cast<SharedFrameHeader*>(const_cast<void*>(this->memory.constData()));
+}
+
+quint32* SharedMemoryVideoSink::buffer(int index) const
+{
+    return reinterpret_cast<quint32*>(this->header() + 1) + index * FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT;
+}
+
+// Frames are drawn into the back buffer, readers only ever see the front one
+quint32* SharedMemoryVideoSink::lockFrame(int* pitch)
+{
+    *pitch = FRAMEBUFFER_WIDTH;
+
+    if (this->fallback)
+        return this->fallback;
+
+    return this->buffer(this->header()->front ^ 1);
+}
+
+void SharedMemoryVideoSink::unlockFrame()
+{
+    if (this->fallback)
+        return;
+
+    this->memory.lock();
+
+    SharedFrameHeader* header = this->header();
+    header->front ^= 1;
+    header->frame++;
+
+    this->memory.unlock();
+}
+
+void* SharedMemoryVideoSink::frame() const
+{
+    if (this->fallback)
+        return this->fallback;
+
+    return this->buffer(this->header()->front);
+}
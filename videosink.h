@@ -0,0 +1,102 @@
+#ifndef VIDEOSINK_H
+#define VIDEOSINK_H
+
+#include <QtGlobal>
+#include <QFile>
+#include <QSharedMemory>
+
+#include <SDL2/SDL.h>
+
+/*
+ * Receives the frames drawn by the VDP.
+ *
+ * The VDP draws straight into the buffer returned by lockFrame() and hands it back
+ * through unlockFrame() once the frame is complete. Buffers hold FRAMEBUFFER_WIDTH x
+ * FRAMEBUFFER_HEIGHT ARGB pixels, the pitch is given in pixels.
+ */
+class VideoSink
+{
+public:
+    virtual ~VideoSink() {}
+
+    virtual quint32*    lockFrame(int* pitch) = 0;
+    virtual void        unlockFrame() = 0;
+
+    // Handle passed on with VDP::frameUpdated()
+    virtual void*       frame() const { return nullptr; }
+};
+
+// Keeps a single buffer and drops every frame
+class NullVideoSink : public VideoSink
+{
+public:
+    NullVideoSink();
+    ~NullVideoSink();
+
+    quint32*    lockFrame(int* pitch) override;
+    void        unlockFrame() override;
+    void*       frame() const override;
+
+protected:
+    quint32*    buffer;
+};
+
+// Uploads frames to a streaming texture, the texture is the frame handle
+class SDLVideoSink : public VideoSink
+{
+public:
+    explicit SDLVideoSink(SDL_Renderer* renderer);
+    ~SDLVideoSink();
+
+    quint32*    lockFrame(int* pitch) override;
+    void        unlockFrame() override;
+    void*       frame() const override;
+
+private:
+    SDL_Texture*    texture;
+};
+
+// Appends every frame as raw ARGB rows to a file
+class RawFileVideoSink : public NullVideoSink
+{
+public:
+    explicit RawFileVideoSink(const QString& fileName);
+
+    void        unlockFrame() override;
+
+private:
+    QFile       file;
+};
+
+// Publishes frames in a shared memory segment for other processes.
+// The segment starts with a SharedFrameHeader followed by two frame buffers,
+// front names the buffer holding the last complete frame.
+struct SharedFrameHeader {
+    quint32 width;
+    quint32 height;
+    quint32 pitch;
+    quint32 frame;
+    quint32 front;
+    quint32 reserved[11];
+};
+
+class SharedMemoryVideoSink : public VideoSink
+{
+public:
+    explicit SharedMemoryVideoSink(const QString& key);
+    ~SharedMemoryVideoSink();
+
+    quint32*    lockFrame(int* pitch) override;
+    void        unlockFrame() override;
+    void*       frame() const override;
+
+private:
+    SharedFrameHeader* header() const;
+    quint32*    buffer(int index) const;
+
+private:
+    QSharedMemory   memory;
+    quint32*        fallback;
+};
+
+#endif // VIDEOSINK_H